@@ -5,26 +5,48 @@
 
 #include "connection.h"
 #include "conn_factory.h"
+#include "conn_limiter.h"
 #include "firewall.h"
 #include "inet_addr.h"
 #include "net_except.h"
+#include "reactor_interrupter.h"
 
 using namespace iqnet;
 
 
-Acceptor::Acceptor( const iqnet::Inet_addr& bind_addr, Accepted_conn_factory* factory_, Reactor_base* reactor_ ):
+Acceptor::Acceptor(
+  const iqnet::Inet_addr& bind_addr,
+  Accepted_conn_factory* factory_,
+  Reactor_base* reactor_,
+  bool reuse_port,
+  unsigned backlog
+):
   factory(factory_),
   reactor(reactor_),
-  firewall(0)
+  firewall(0),
+  accept_budget(0),
+  limiter(0),
+  interrupter(0),
+  paused(false)
 {
+  if( reuse_port )
+    sock.set_reuse_port( true );
+
   sock.bind( bind_addr );
-  listen();
+  sock.listen( backlog );
+  sock.set_non_blocking( true );
   reactor->register_handler( this, Reactor_base::INPUT );
 }
 
 
 Acceptor::~Acceptor()
 {
+  if( limiter )
+    limiter->cancel_pause( this );
+
+  if( interrupter )
+    interrupter->cancel_events( this );
+
   reactor->unregister_handler(this);
   sock.close();
 }
@@ -37,21 +59,84 @@ void Acceptor::set_firewall( iqnet::Firewall_base* fw )
 }
 
 
+void Acceptor::set_accept_budget( unsigned budget )
+{
+  accept_budget = budget;
+}
+
+
+void Acceptor::set_socket_options( const Socket_options& opts )
+{
+  Socket_options listen_opts;
+  listen_opts.send_buf_sz = opts.send_buf_sz;
+  listen_opts.recv_buf_sz = opts.recv_buf_sz;
+  sock.set_options( listen_opts );
+
+  sock_opts = opts;
+}
+
+
+void Acceptor::set_conn_limiter( Conn_limiter* l, Reactor_interrupter* i )
+{
+  limiter = l;
+  interrupter = i;
+}
+
+
+void Acceptor::set_defer_accept( unsigned timeout )
+{
+  sock.set_defer_accept( timeout );
+}
+
+
 void Acceptor::handle_input( bool& )
 {
-  accept();
+  if( paused )
+  {
+    paused = false;
+    reactor->register_handler( this, Reactor_base::INPUT );
+  }
+
+  for( unsigned n = 0; !accept_budget || n < accept_budget; ++n )
+  {
+    if( limiter && limiter->pause_if_full( this ) )
+    {
+      pause();
+      break;
+    }
+
+    if( !accept() )
+      break;
+  }
+}
+
+
+void Acceptor::pause()
+{
+  // Stay registered with empty mask: the listen queue is not polled
+  // any more, but the reactor still delivers resume() event.
+  reactor->unregister_handler( this );
+  reactor->register_handler( this, Reactor_base::Event_mask(0) );
+  paused = true;
 }
 
 
-inline void Acceptor::listen()
+void Acceptor::resume()
 {
-  sock.listen( 100 );
+  if( interrupter )
+    interrupter->post_event( this, Reactor_base::INPUT );
+  else
+    reactor->fake_event( this, Reactor_base::INPUT );
 }
 
 
-void Acceptor::accept()
+bool Acceptor::accept()
 {
-  Socket new_sock( sock.accept() );
+  boost::optional<Socket> accepted( sock.accept_nonblocking() );
+  if( !accepted )
+    return false;
+
+  Socket& new_sock = *accepted;
 
   if( firewall && !firewall->grant( new_sock.get_peer_addr() ) )
   {
@@ -64,8 +149,38 @@ void Acceptor::accept()
       new_sock.shutdown();
     }
 
-    return;
+    return true;
+  }
+
+  if( sock_opts )
+  {
+    try {
+      new_sock.set_options( *sock_opts );
+    }
+    catch( const network_error& )
+    {
+      // Most likely connection is already reset by peer.
+      new_sock.close();
+      return true;
+    }
+  }
+
+  if( limiter && !limiter->acquire( new_sock.get_peer_addr() ) )
+  {
+    new_sock.close();
+    return true;
+  }
+
+  try {
+    factory->create_accepted( new_sock, reactor );
+  }
+  catch( ... )
+  {
+    if( limiter )
+      limiter->release( new_sock.get_peer_addr() );
+
+    throw;
   }
 
-  factory->create_accepted( new_sock );
+  return true;
 }
@@ -8,10 +8,14 @@
 #include "reactor.h"
 #include "socket.h"
 
+#include <boost/optional.hpp>
+
 namespace iqnet {
 
 class Accepted_conn_factory;
+class Conn_limiter;
 class Firewall_base;
+class Reactor_interrupter;
 
 //! An implementation of pattern that separates TCP-connection
 //! establishment from connection handling.
@@ -26,21 +30,61 @@ class LIBIQXMLRPC_API Acceptor: public Event_handler {
   Accepted_conn_factory *factory;
   Reactor_base *reactor;
   Firewall_base* firewall;
+  unsigned accept_budget;
+  boost::optional<Socket_options> sock_opts;
+  Conn_limiter* limiter;
+  Reactor_interrupter* interrupter;
+  bool paused;
 
 public:
-  Acceptor( const iqnet::Inet_addr& bind_addr, Accepted_conn_factory*, Reactor_base* );
+  //! \param reuse_port Bind with SO_REUSEPORT, so several acceptors
+  //! can listen the same address.
+  //! \param backlog Size of listen queue.
+  Acceptor( const iqnet::Inet_addr& bind_addr, Accepted_conn_factory*, Reactor_base*,
+            bool reuse_port = false, unsigned backlog = 100 );
   virtual ~Acceptor();
 
   void set_firewall( iqnet::Firewall_base* );
 
+  //! Set maximum number of connections accepted per one wakeup.
+  //! Zero (default) means accept until listen queue is empty.
+  void set_accept_budget( unsigned );
+
+  //! Set TCP options applied to each accepted socket.
+  /*! Buffer sizes are also set for listening socket,
+      so they are inherited from the very beginning of connection. */
+  void set_socket_options( const Socket_options& );
+
+  //! Set shared counter which limits number of connections.
+  /*! When total limit is reached acceptor stops listening socket
+      until number of connections drops below low watermark.
+      Connections over per IP limit are closed right after accepting.
+      Accepted connection must call Conn_limiter::release() on close.
+      \param interrupter Used to resume acceptor when connections
+      are closed in other threads than reactor's one. */
+  void set_conn_limiter( Conn_limiter*, Reactor_interrupter* interrupter = 0 );
+
+  //! Start listening socket again after pause.
+  //! Called by Conn_limiter when connections are closed.
+  void resume();
+
+  //! Wake up only when data arrives on accepted connection
+  //! or timeout in seconds expires (TCP_DEFER_ACCEPT).
+  void set_defer_accept( unsigned timeout );
+
+  //! Returns address the acceptor actually listens.
+  Inet_addr get_addr() const { return sock.get_addr(); }
+
   void handle_input( bool& );
 
 protected:
   void finish() {}
   Socket::Handler get_handler() const { return sock.get_handler(); }
 
-  void accept();
-  void listen();
+  bool accept();
+
+private:
+  void pause();
 };
 
 } // namespace iqnet
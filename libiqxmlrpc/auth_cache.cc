@@ -0,0 +1,157 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "auth_cache.h"
+#include "except.h"
+#include "timer_wheel.h"
+
+#include <boost/thread/mutex.hpp>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+
+namespace iqxmlrpc {
+
+namespace {
+
+const size_t max_shards = 16;
+
+//! Small caches are not split, so that LRU order is kept exactly.
+const size_t min_shard_sz = 64;
+
+} // anonymous namespace
+
+class Auth_cache::Shard {
+  struct Entry {
+    std::string key;
+    std::string user;
+    iqnet::Timer_wheel::Msec expires;
+  };
+
+  typedef std::list<Entry> Lru_list;
+  typedef std::map<std::string, Lru_list::iterator> Index;
+
+  boost::mutex lock;
+  //! Most recently used entries go first.
+  Lru_list lru;
+  Index index;
+  size_t capacity;
+
+public:
+  Shard():
+    capacity(0) {}
+
+  void set_capacity( size_t c ) { capacity = c; }
+
+  bool find( const std::string& key, iqnet::Timer_wheel::Msec now, std::string& user )
+  {
+    boost::mutex::scoped_lock lk(lock);
+
+    Index::iterator i = index.find(key);
+    if (i == index.end())
+      return false;
+
+    if (i->second->expires <= now)
+    {
+      lru.erase(i->second);
+      index.erase(i);
+      return false;
+    }
+
+    lru.splice(lru.begin(), lru, i->second);
+    user = i->second->user;
+    return true;
+  }
+
+  void insert( const std::string& key, const std::string& user, iqnet::Timer_wheel::Msec expires )
+  {
+    boost::mutex::scoped_lock lk(lock);
+
+    Index::iterator i = index.find(key);
+    if (i != index.end())
+    {
+      lru.splice(lru.begin(), lru, i->second);
+    }
+    else
+    {
+      lru.push_front(Entry());
+      lru.front().key = key;
+      index[key] = lru.begin();
+    }
+
+    lru.front().user = user;
+    lru.front().expires = expires;
+
+    while (lru.size() > capacity)
+    {
+      index.erase(lru.back().key);
+      lru.pop_back();
+    }
+  }
+
+  void clear()
+  {
+    boost::mutex::scoped_lock lk(lock);
+    lru.clear();
+    index.clear();
+  }
+};
+
+Auth_cache::Auth_cache( size_t max_entries, unsigned ttl_sec ):
+  num_shards(std::max<size_t>(1, std::min(max_entries / min_shard_sz, max_shards))),
+  ttl(ttl_sec)
+{
+  if (RAND_bytes(secret, sizeof(secret)) != 1)
+    throw Exception("Can not generate key of credentials cache.");
+
+  shards.reset(new Shard[num_shards]);
+
+  for (size_t i = 0; i < num_shards; ++i)
+    shards[i].set_capacity((max_entries + num_shards - 1) / num_shards);
+}
+
+Auth_cache::~Auth_cache()
+{
+}
+
+std::string Auth_cache::hash( const std::string& s ) const
+{
+  unsigned char md[EVP_MAX_MD_SIZE];
+  unsigned int len = 0;
+
+  HMAC(EVP_sha256(), secret, sizeof(secret),
+    reinterpret_cast<const unsigned char*>(s.data()), s.length(), md, &len);
+
+  return std::string(reinterpret_cast<const char*>(md), len);
+}
+
+Auth_cache::Shard& Auth_cache::shard_of( const std::string& key )
+{
+  return shards[static_cast<unsigned char>(key[0]) % num_shards];
+}
+
+bool Auth_cache::find( const std::string& authinfo, std::string& user )
+{
+  std::string key(hash(authinfo));
+  return shard_of(key).find(key, iqnet::Timer_wheel::now(), user);
+}
+
+void Auth_cache::insert( const std::string& authinfo, const std::string& user )
+{
+  std::string key(hash(authinfo));
+  shard_of(key).insert(key, user, iqnet::Timer_wheel::now() + ttl * iqnet::Timer_wheel::Msec(1000));
+}
+
+void Auth_cache::clear()
+{
+  for (size_t i = 0; i < num_shards; ++i)
+    shards[i].clear();
+}
+
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
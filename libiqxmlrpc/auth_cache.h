@@ -0,0 +1,62 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_auth_cache_h_
+#define _iqxmlrpc_auth_cache_h_
+
+#include "api_export.h"
+
+#include <boost/scoped_array.hpp>
+#include <boost/utility.hpp>
+
+#include <string>
+
+namespace iqxmlrpc {
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#pragma warning(disable: 4275)
+#endif
+
+//! Thread safe cache of successfully verified HTTP credentials.
+/*! Entries are keyed by HMAC-SHA256 of raw Authorization option value
+    with a random key generated for every cache, so credentials are not
+    kept in memory. Large cache is split into shards chosen by the hash,
+    each one has its own lock and evicts least recently used entries. */
+class LIBIQXMLRPC_API Auth_cache: boost::noncopyable {
+public:
+  //! \param max_entries Total number of entries.
+  //! \param ttl Seconds an entry is valid after verification.
+  Auth_cache( size_t max_entries, unsigned ttl );
+  ~Auth_cache();
+
+  //! Find user name verified with specified Authorization value.
+  //! \return false if credentials are not cached or expired.
+  bool find( const std::string& authinfo, std::string& user );
+
+  //! Remember that credentials of the user are verified.
+  void insert( const std::string& authinfo, const std::string& user );
+
+  void clear();
+
+private:
+  class Shard;
+
+  std::string hash( const std::string& ) const;
+  Shard& shard_of( const std::string& key );
+
+  boost::scoped_array<Shard> shards;
+  size_t num_shards;
+  unsigned ttl;
+  unsigned char secret[32];
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
@@ -0,0 +1,66 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "buffer_chain.h"
+
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
+using namespace iqnet;
+
+void Buffer_chain::append( std::string& s )
+{
+  if( s.empty() )
+    return;
+
+  segments.push_back( std::string() );
+  segments.back().swap( s );
+  total += segments.back().length();
+}
+
+void Buffer_chain::clear()
+{
+  segments.clear();
+  first = 0;
+  offset = 0;
+  total = 0;
+}
+
+void Buffer_chain::consume( size_t n )
+{
+  total -= n;
+  n += offset;
+
+  while( first < segments.size() && n >= segments[first].length() )
+  {
+    n -= segments[first].length();
+    std::string().swap( segments[first++] );
+  }
+
+  offset = n;
+
+  if( first == segments.size() )
+  {
+    segments.clear();
+    first = 0;
+  }
+}
+
+#ifndef WIN32
+size_t Buffer_chain::fill_iovec( struct iovec* iov, size_t max_count ) const
+{
+  size_t count = 0;
+  size_t off = offset;
+
+  for( std::vector<std::string>::const_iterator i = segments.begin() + first;
+       i != segments.end() && count < max_count; ++i, ++count )
+  {
+    iov[count].iov_base = const_cast<char*>(i->data() + off);
+    iov[count].iov_len = i->length() - off;
+    off = 0;
+  }
+
+  return count;
+}
+#endif
@@ -0,0 +1,69 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _libiqnet_buffer_chain_h_
+#define _libiqnet_buffer_chain_h_
+
+#include "api_export.h"
+
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+struct iovec;
+#endif
+
+namespace iqnet
+{
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
+//! Chain of output buffers with a send cursor.
+/*! Data is kept in separate segments (e.g. HTTP header and body),
+    which are sent as is by single gather write. Sent data is only
+    skipped by the cursor, so partial writes never move memory.
+    Segments are released as soon as they are sent.
+*/
+class LIBIQXMLRPC_API Buffer_chain {
+  std::vector<std::string> segments;
+  size_t first;
+  size_t offset;
+  size_t total;
+
+public:
+  Buffer_chain():
+    first(0), offset(0), total(0) {}
+
+  //! Append segment. Grabs the string's content leaving it empty.
+  void append( std::string& );
+
+  void clear();
+
+  bool empty() const { return !total; }
+
+  //! Number of bytes not sent yet.
+  size_t size() const { return total; }
+
+  //! Not sent part of the first segment.
+  const char* data() const { return segments[first].data() + offset; }
+  size_t length() const { return segments[first].length() - offset; }
+
+  //! Move cursor forward by number of bytes sent.
+  void consume( size_t );
+
+#ifndef WIN32
+  //! Describe not sent data with at most max_count iovec entries.
+  size_t fill_iovec( struct iovec*, size_t max_count ) const;
+#endif
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+} // namespace iqnet
+
+#endif
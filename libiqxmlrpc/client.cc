@@ -4,6 +4,8 @@
 #include "client.h"
 #include "client_conn.h"
 #include "client_opts.h"
+#include "net_except.h"
+#include "ssl_lib.h"
 
 namespace iqxmlrpc {
 
@@ -31,11 +33,14 @@ public:
 class Auto_conn: boost::noncopyable {
 public:
   Auto_conn( Client_base::Impl& client_impl, Client_base& client ):
-    client_impl_(client_impl)
+    client_impl_(client_impl),
+    reused_(false)
   {
     if (opts().keep_alive())
     {
-      if (!cimpl().conn_cache)
+      reused_ = cimpl().conn_cache.get() != 0;
+
+      if (!reused_)
         cimpl().conn_cache.reset( create_connection(client) );
 
       conn_ptr_ = cimpl().conn_cache.get();
@@ -46,12 +51,23 @@ public:
     }
   }
 
+  //! Drops cached connection unless the last call through it
+  //! succeeded and server agreed to keep it open.
   ~Auto_conn()
   {
-    if (!cimpl().opts.keep_alive())
+    if (!cimpl().opts.keep_alive() || !conn_ptr_->reusable())
       cimpl().conn_cache.reset();
   }
 
+  //! Whether failed call may be repeated over a new connection.
+  /*! Only a kept-alive connection which server could close while
+      it was idle is considered stale, and only when no part
+      of response was received through it. */
+  bool may_retry() const
+  {
+    return reused_ && opts().auto_retry() && !conn_ptr_->response_started();
+  }
+
   Client_connection* operator ->()
   {
     return conn_ptr_;
@@ -63,7 +79,7 @@ private:
     return client.get_connection();
   }
 
-  const Client_options& opts()
+  const Client_options& opts() const
   {
     return client_impl_.opts;
   }
@@ -76,6 +92,7 @@ private:
   Client_base::Impl& client_impl_;
   boost::scoped_ptr<Client_connection> tmp_conn_;
   Client_connection* conn_ptr_;
+  bool reused_;
 };
 
 //
@@ -119,6 +136,21 @@ void Client_base::set_keep_alive( bool keep_alive )
     impl_->conn_cache.reset();
 }
 
+void Client_base::set_auto_retry( bool retry )
+{
+  impl_->opts.set_auto_retry(retry);
+}
+
+void Client_base::set_compress_requests( bool compress )
+{
+  impl_->opts.set_compress_requests(compress);
+}
+
+void Client_base::set_expect_continue( size_t body_sz, unsigned wait_ms )
+{
+  impl_->opts.set_expect_continue(body_sz, wait_ms);
+}
+
 void Client_base::set_authinfo( const std::string& u, const std::string& p )
 {
   impl_->opts.set_authinfo( u, p );
@@ -129,15 +161,60 @@ void Client_base::set_xheaders( const XHeaders& xheaders)
   impl_->opts.set_xheaders(xheaders);
 }
 
+void Client_base::set_socket_options( const iqnet::Socket_options& opts )
+{
+  impl_->opts.set_socket_options(opts);
+}
+
+const iqnet::Socket_options& Client_base::socket_options() const
+{
+  return impl_->opts.socket_options();
+}
+
 Response Client_base::execute(
   const std::string& method, const Param_list& pl, const XHeaders& xheaders )
 {
   Request req( method, pl );
 
-  Auto_conn conn( *impl_.get(), *this );
-  conn->set_options(impl_->opts);
+  for (;;)
+  {
+    Auto_conn conn( *impl_.get(), *this );
+    conn->set_options(impl_->opts);
+
+    try {
+      return conn->process_session( req, xheaders );
+    }
+    catch (const iqnet::network_error&) {
+      if (!conn.may_retry())
+        throw;
+    }
+    catch (const iqnet::ssl::exception&) {
+      if (!conn.may_retry())
+        throw;
+    }
+  }
+}
+
+std::vector<Response> Client_base::execute_pipelined(
+  const std::vector<Request>& reqs, const XHeaders& xheaders )
+{
+  for (;;)
+  {
+    Auto_conn conn( *impl_.get(), *this );
+    conn->set_options(impl_->opts);
 
-  return conn->process_session( req, xheaders );
+    try {
+      return conn->process_pipeline( reqs, xheaders );
+    }
+    catch (const iqnet::network_error&) {
+      if (!conn.may_retry())
+        throw;
+    }
+    catch (const iqnet::ssl::exception&) {
+      if (!conn.may_retry())
+        throw;
+    }
+  }
 }
 
 } // namespace iqxmlrpc
@@ -43,6 +43,16 @@ public:
     return execute( method, pl );
   }
 
+  //! Perform several calls without waiting for each response.
+  /*! Requests are sent back to back over one connection (HTTP
+      pipelining), responses are returned in order of requests.
+      Server must support HTTP/1.1 pipelining. Connection is kept
+      open until the last response regardless of keep-alive flag.
+      Through HTTPS proxy requests are performed one by one.
+  */
+  std::vector<Response> execute_pipelined(
+    const std::vector<Request>&, const XHeaders& xheaders = XHeaders() );
+
   //! Set address where actually connect to. <b>Tested with HTTP only.</b>
   void set_proxy(const iqnet::Inet_addr&);
 
@@ -51,16 +61,46 @@ public:
   */
   void set_timeout( int seconds );
 
-  //! Set connection keep-alive flag
+  //! Set connection keep-alive flag (on by default).
+  /*! Requests are sent as HTTP/1.1 and connection is reused for
+      subsequent calls until server asks to close it. */
   void set_keep_alive( bool keep_alive );
 
+  //! Repeat call once over a new connection when kept-alive connection
+  //! turns out to be closed by server (off by default).
+  /*! Call is repeated only if no part of response was received.
+      Server still might execute the request before closing the
+      connection, so turn it on only when calls are idempotent.
+      Otherwise such call fails with network error and the next one
+      opens a new connection. */
+  void set_auto_retry( bool retry );
+
+  //! Send requests compressed with gzip. Server must support it.
+  /*! Has no effect when library is built without zlib. Compressed
+      responses are accepted and decompressed in any case, up to
+      100 times the received size or 1 MB, whichever is greater. */
+  void set_compress_requests( bool compress );
+
+  //! Send request body of at least specified size (in bytes) only after
+  //! server confirms it with interim response (Expect: 100-continue).
+  /*! If server does not respond in wait_ms milliseconds the body is sent
+      anyway. When server rejects request by final response (e.g. because
+      of size or authentication) the body is not sent at all and connection
+      is closed. Zero size (default) turns it off. Pipelined requests and
+      requests tunneled through HTTPS proxy are always sent at once. */
+  void set_expect_continue( size_t body_sz, unsigned wait_ms = 1000 );
+
   //! Set data for HTTP Basic authentication
   void set_authinfo(const std::string& user, const std::string& password);
 
   void set_xheaders(const XHeaders& xheaders);
 
+  //! Set TCP options for new connections (TCP_NODELAY is on by default).
+  void set_socket_options(const iqnet::Socket_options&);
+
 protected:
   int timeout() const;
+  const iqnet::Socket_options& socket_options() const;
 
 private:
   virtual void do_set_proxy( const iqnet::Inet_addr& ) = 0;
@@ -103,8 +143,12 @@ private:
   virtual Client_connection* get_connection()
   {
     if (proxy_ctr)
+    {
+      proxy_ctr->set_socket_options(socket_options());
       return proxy_ctr->connect(timeout());
+    }
 
+    ctr.set_socket_options(socket_options());
     return ctr.connect(timeout());
   }
 
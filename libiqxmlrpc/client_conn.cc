@@ -4,11 +4,25 @@
 #include "client_conn.h"
 #include "client_opts.h"
 #include "http.h"
+#include "http_errors.h"
+#include "util.h"
 
 namespace iqxmlrpc {
 
+namespace {
+
+int response_code( const http::Packet* p )
+{
+  return static_cast<const http::Response_header*>(p->header())->code();
+}
+
+} // anonymous namespace
+
 Client_connection::Client_connection():
-  read_buf_(65536, '\0')
+  options(0),
+  reusable_(false),
+  received_(false),
+  continue_(false)
 {
 }
 
@@ -16,7 +30,21 @@ Client_connection::~Client_connection()
 {
 }
 
-Response Client_connection::process_session( const Request& req, const XHeaders& xheaders )
+char* Client_connection::read_buf()
+{
+  if( read_buf_.empty() )
+    read_buf_.resize( read_buf_size );
+
+  return &read_buf_[0];
+}
+
+void Client_connection::release_read_buf()
+{
+  std::vector<char>().swap( read_buf_ );
+}
+
+std::string Client_connection::dump_request_packet(
+  const Request& req, const XHeaders& xheaders, bool keep_alive, std::string* body )
 {
   using namespace http;
 
@@ -34,24 +62,142 @@ Response Client_connection::process_session( const Request& req, const XHeaders&
   req_h->set_xheaders( opts().xheaders() );
   req_h->set_xheaders( xheaders );
 
+  if (content_coding_supported())
+    req_h->set_accept_encoding( accepted_codings() );
+
   Packet req_p( req_h.release(), req_xml_str );
-  req_p.set_keep_alive( opts().keep_alive() );
+  req_p.set_keep_alive( keep_alive );
 
-  // Received packet
-  std::auto_ptr<Packet> res_p( do_process_session(req_p.dump()) );
+  if (opts().compress_requests() && content_coding_supported())
+    req_p.encode_content( CODING_GZIP );
+
+  size_t expect_sz = opts().expect_continue_sz();
+  if (body && expect_sz && req_p.content().length() >= expect_sz)
+  {
+    req_p.set_expect_continue();
+    std::string head( req_p.header()->dump() );
+    req_p.swap_content( *body );
+    return head;
+  }
+
+  return req_p.dump();
+}
+
+Response Client_connection::parse_response_packet( http::Packet& res_p )
+{
+  using namespace http;
 
   const Response_header* res_h =
-    static_cast<const Response_header*>(res_p->header());
+    static_cast<const Response_header*>(res_p.header());
 
   if( res_h->code() != 200 )
     throw Error_response( res_h->phrase(), res_h->code() );
 
-  return parse_response( res_p->content() );
+  try {
+    res_p.decode_content( max_decoded_sz(res_p.content().length()) );
+  }
+  catch( const Request_too_large& )
+  {
+    throw Malformed_packet( "decompressed response is too large" );
+  }
+
+  return parse_response( res_p.content() );
+}
+
+Response Client_connection::process_session( const Request& req, const XHeaders& xheaders )
+{
+  received_ = false;
+  return perform_session( req, xheaders );
+}
+
+Response Client_connection::perform_session( const Request& req, const XHeaders& xheaders )
+{
+  reusable_ = false;
+  continue_ = false;
+
+  std::string body;
+  std::string head( dump_request_packet(req, xheaders, opts().keep_alive(), &body) );
+
+  // Received packet
+  std::auto_ptr<http::Packet> res_p(
+    body.empty() ? do_process_session(head) : do_process_continue(head, body) );
+  release_read_buf();
+
+  reusable_ = opts().keep_alive() && res_p->header()->conn_keep_alive();
+
+  return parse_response_packet( *res_p );
+}
+
+std::vector<Response> Client_connection::process_pipeline(
+  const std::vector<Request>& reqs, const XHeaders& xheaders )
+{
+  std::vector<Response> retval;
+  retval.reserve( reqs.size() );
+  received_ = false;
+
+  if( !can_pipeline() )
+  {
+    for( size_t i = 0; i < reqs.size(); ++i )
+      retval.push_back( perform_session(reqs[i], xheaders) );
+
+    return retval;
+  }
+
+  // Connection must survive all requests but the last one.
+  std::string out;
+  for( size_t i = 0; i < reqs.size(); ++i )
+  {
+    bool last = i + 1 == reqs.size();
+    out += dump_request_packet( reqs[i], xheaders, opts().keep_alive() || !last );
+  }
+
+  // All responses are read before any of them is checked,
+  // so that connection is left in consistent state.
+  std::vector<http::Packet*> packets;
+  packets.reserve( reqs.size() );
+
+  reusable_ = false;
+
+  try {
+    for( size_t i = 0; i < reqs.size(); ++i )
+      packets.push_back( do_process_session(i ? std::string() : out) );
+
+    release_read_buf();
+
+    if( !packets.empty() )
+      reusable_ = opts().keep_alive() && packets.back()->header()->conn_keep_alive();
+
+    for( size_t i = 0; i < packets.size(); ++i )
+      retval.push_back( parse_response_packet(*packets[i]) );
+  }
+  catch( ... )
+  {
+    util::delete_ptrs( packets.begin(), packets.end() );
+    throw;
+  }
+
+  util::delete_ptrs( packets.begin(), packets.end() );
+  return retval;
 }
 
-http::Packet* Client_connection::read_response( const std::string& s, bool hdr_only )
+http::Packet* Client_connection::read_response( const char* s, size_t len, bool hdr_only )
 {
-  return preader.read_response( s, hdr_only );
+  if( len )
+    received_ = true;
+
+  http::Packet* p = preader.read_response( s, len, hdr_only );
+
+  // Interim responses are skipped.
+  while( p && !hdr_only && response_code(p) / 100 == 1 )
+  {
+    if( response_code(p) == 100 )
+      continue_ = true;
+
+    delete p;
+    p = preader.has_pending() ? preader.read_response( 0, 0 ) : 0;
+  }
+
+  return p;
 }
 
 std::string Client_connection::decorate_uri() const
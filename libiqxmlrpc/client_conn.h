@@ -22,23 +22,74 @@ public:
 
   void set_options(const Client_options& o) { options = &o; }
 
+  //! Whether server agreed to keep connection open after last response.
+  bool reusable() const { return reusable_; }
+
+  //! Whether some part of response to current call is received.
+  bool response_started() const { return received_; }
+
   Response process_session(const Request&, const XHeaders& xheaders = XHeaders());
 
+  //! Send all requests at once and read responses in the same order.
+  std::vector<Response> process_pipeline(
+    const std::vector<Request>&, const XHeaders& xheaders = XHeaders());
+
 protected:
-  http::Packet* read_response( const std::string&, bool read_hdr_only = false );
+  http::Packet* read_response( const char*, size_t, bool read_hdr_only = false );
+
+  //! Response which has been received along with previous one.
+  http::Packet* read_buffered_response()
+  {
+    return preader.has_pending() ? read_response( 0, 0 ) : 0;
+  }
+
+  //! Send data and read one response.
+  /*! Empty string means that request has been sent before
+      (pipelining), so only its response is read. */
   virtual http::Packet* do_process_session( const std::string& ) = 0;
 
+  //! Send request header, then its body as soon as server confirms it
+  //! (see continue_received()), and read response. Grabs the body.
+  /*! By default everything is sent at once. */
+  virtual http::Packet* do_process_continue( const std::string& head, std::string& body )
+  {
+    return do_process_session( head + body );
+  }
+
+  //! Whether interim "100 Continue" response was received during current call.
+  bool continue_received() const { return continue_; }
+
+  //! Whether responses to pipelined requests can be read one by one.
+  virtual bool can_pipeline() const { return true; }
+
   const Client_options& opts() const { return *options; }
 
-  char* read_buf() { return &read_buf_[0]; }
-  size_t read_buf_sz() const { return read_buf_.size(); }
+  //! Buffer is allocated on first use and released as soon as
+  //! responses of the call are read, so idle connections kept
+  //! for next calls do not hold it.
+  char* read_buf();
+  size_t read_buf_sz() const { return read_buf_size; }
 
 private:
   virtual std::string decorate_uri() const;
 
+  //! \param body If given and request body is large enough (see
+  //! Client_options::expect_continue_sz()), only header is returned
+  //! while body is put here.
+  std::string dump_request_packet(
+    const Request&, const XHeaders&, bool keep_alive, std::string* body = 0 );
+  Response parse_response_packet( http::Packet& );
+  Response perform_session( const Request&, const XHeaders& );
+  void release_read_buf();
+
   http::Packet_reader preader;
   const Client_options* options;
   std::vector<char> read_buf_;
+  bool reusable_;
+  bool received_;
+  bool continue_;
+
+  static const size_t read_buf_size = 65536;
 };
 
 //! Exception which be thrown by client when timeout occured.
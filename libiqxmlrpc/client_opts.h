@@ -6,6 +6,7 @@
 
 #include <string>
 #include "inet_addr.h"
+#include "socket.h"
 #include "xheaders.h"
 
 namespace iqxmlrpc {
@@ -20,7 +21,11 @@ public:
     addr_(addr),
     uri_(uri),
     vhost_(vhost.empty() ? addr.get_host_name() : vhost),
-    keep_alive_(false),
+    keep_alive_(true),
+    auto_retry_(false),
+    compress_requests_(false),
+    expect_continue_sz_(0),
+    expect_continue_wait_(0),
     timeout_(-1),
     non_blocking_flag_(false)
   {
@@ -32,12 +37,18 @@ public:
   int                      timeout()      const { return timeout_; }
   bool                     non_blocking() const { return non_blocking_flag_; }
   bool                     keep_alive()   const { return keep_alive_; }
+  bool                     auto_retry()   const { return auto_retry_; }
+  bool                     compress_requests() const { return compress_requests_; }
+  size_t                   expect_continue_sz()   const { return expect_continue_sz_; }
+  unsigned                 expect_continue_wait() const { return expect_continue_wait_; }
 
   bool                     has_authinfo() const { return !auth_user_.empty(); }
   const std::string&       auth_user()    const { return auth_user_; }
   const std::string&       auth_passwd()  const { return auth_passwd_; }
   const XHeaders&          xheaders()     const { return xheaders_; }
 
+  const iqnet::Socket_options& socket_options() const { return sock_opts_; }
+
   void set_timeout( int seconds )
   {
     if( (timeout_ = seconds) > 0 )
@@ -49,6 +60,22 @@ public:
     keep_alive_ = keep_alive;
   }
 
+  void set_auto_retry( bool retry )
+  {
+    auto_retry_ = retry;
+  }
+
+  void set_compress_requests( bool compress )
+  {
+    compress_requests_ = compress;
+  }
+
+  void set_expect_continue( size_t body_sz, unsigned wait_ms )
+  {
+    expect_continue_sz_ = body_sz;
+    expect_continue_wait_ = wait_ms;
+  }
+
   void set_authinfo( const std::string& user, const std::string& password )
   {
     auth_user_ = user;
@@ -60,11 +87,20 @@ public:
     xheaders_ = xheaders;
   }
 
+  void set_socket_options( const iqnet::Socket_options& opts )
+  {
+    sock_opts_ = opts;
+  }
+
 private:
   iqnet::Inet_addr addr_;
   std::string      uri_;
   std::string      vhost_;
   bool             keep_alive_;
+  bool             auto_retry_;
+  bool             compress_requests_;
+  size_t           expect_continue_sz_;
+  unsigned         expect_continue_wait_;
 
   int              timeout_;
   bool             non_blocking_flag_;
@@ -73,6 +109,8 @@ private:
   std::string      auth_passwd_;
 
   XHeaders         xheaders_;
+
+  iqnet::Socket_options sock_opts_;
 };
 
 } // namespace iqxmlrpc
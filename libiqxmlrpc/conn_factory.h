@@ -9,11 +9,24 @@
 namespace iqnet
 {
 
+class Reactor_base;
+
 //! Abstract factory for accepted connections.
 class LIBIQXMLRPC_API Accepted_conn_factory {
 public:
   virtual ~Accepted_conn_factory() {}
+
+  //! Create connection for accepted socket.
   virtual void create_accepted( const Socket& ) = 0;
+
+  //! Create connection for accepted socket.
+  //! Connection should be served by specified reactor.
+  //! Default one calls create_accepted(const Socket&),
+  //! so factories which do not know about reactors keep working.
+  virtual void create_accepted( const Socket& sock, Reactor_base* )
+  {
+    create_accepted( sock );
+  }
 };
 
 
@@ -22,12 +35,22 @@ template <class Conn_type>
 class Serial_conn_factory: public Accepted_conn_factory {
 public:
   void create_accepted( const Socket& sock )
+  {
+    create_accepted( sock, 0 );
+  }
+
+  void create_accepted( const Socket& sock, Reactor_base* reactor )
   {
     Conn_type* c = new Conn_type( sock );
-    post_create( c );
+    post_create( c, reactor );
     c->post_accept();
   }
 
+  virtual void post_create( Conn_type* c, Reactor_base* )
+  {
+    post_create( c );
+  }
+
   virtual void post_create( Conn_type* ) {}
 };
 
@@ -0,0 +1,124 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "conn_limiter.h"
+#include "acceptor.h"
+
+#include <algorithm>
+
+using namespace iqnet;
+typedef boost::mutex::scoped_lock scoped_lock;
+
+
+Conn_limiter::Conn_limiter():
+  num_conns(0),
+  max_conns(0),
+  low_watermark(0),
+  max_per_ip(0)
+{
+}
+
+
+void Conn_limiter::set_max_connections( size_t max, size_t low )
+{
+  scoped_lock lk(lock);
+  max_conns = max;
+  low_watermark = low && low < max ? low : max - max / 10;
+}
+
+
+void Conn_limiter::set_max_connections_per_ip( size_t max )
+{
+  scoped_lock lk(lock);
+  max_per_ip = max;
+
+  if( !max_per_ip )
+    peers.clear();
+}
+
+
+bool Conn_limiter::acquire( const Inet_addr& peer )
+{
+  scoped_lock lk(lock);
+
+  if( max_conns && num_conns >= max_conns )
+    return false;
+
+  if( max_per_ip )
+  {
+    size_t& n = peers[peer.get_host_name()];
+    if( n >= max_per_ip )
+      return false;
+
+    n++;
+  }
+
+  num_conns++;
+  return true;
+}
+
+
+void Conn_limiter::release( const Inet_addr& peer )
+{
+  scoped_lock lk(lock);
+
+  if( num_conns )
+    num_conns--;
+
+  if( !paused.empty() && (!max_conns || num_conns < low_watermark) )
+  {
+    for( Acceptors::iterator i = paused.begin(); i != paused.end(); ++i )
+      (*i)->resume();
+
+    paused.clear();
+  }
+
+  if( !max_per_ip )
+    return;
+
+  Peer_counts::iterator i = peers.find( peer.get_host_name() );
+  if( i != peers.end() && !--i->second )
+    peers.erase( i );
+}
+
+
+bool Conn_limiter::full() const
+{
+  scoped_lock lk(lock);
+  return max_conns && num_conns >= max_conns;
+}
+
+
+bool Conn_limiter::pause_if_full( Acceptor* a )
+{
+  scoped_lock lk(lock);
+
+  if( !max_conns || num_conns < max_conns )
+    return false;
+
+  if( std::find(paused.begin(), paused.end(), a) == paused.end() )
+    paused.push_back( a );
+
+  return true;
+}
+
+
+void Conn_limiter::cancel_pause( Acceptor* a )
+{
+  scoped_lock lk(lock);
+  paused.erase( std::remove(paused.begin(), paused.end(), a), paused.end() );
+}
+
+
+bool Conn_limiter::below_low_watermark() const
+{
+  scoped_lock lk(lock);
+  return !max_conns || num_conns < low_watermark;
+}
+
+
+size_t Conn_limiter::count() const
+{
+  scoped_lock lk(lock);
+  return num_conns;
+}
@@ -0,0 +1,82 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _libiqnet_conn_limiter_h_
+#define _libiqnet_conn_limiter_h_
+
+#include "inet_addr.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iqnet {
+
+class Acceptor;
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#pragma warning(disable: 4275)
+#endif
+
+//! Thread safe counter of established connections
+//! which enforces total and per peer IP limits.
+/*! Zero limit means no limit. Per IP counters are kept
+    only when per IP limit is set. */
+class LIBIQXMLRPC_API Conn_limiter: boost::noncopyable {
+public:
+  Conn_limiter();
+
+  //! Set maximum number of connections.
+  //! \param low_watermark Number of connections accepting is resumed at.
+  //! Zero means 90% of the maximum.
+  void set_max_connections( size_t max, size_t low_watermark = 0 );
+  void set_max_connections_per_ip( size_t );
+
+  //! Register new connection from specified peer.
+  //! \return false if any of limits is reached.
+  bool acquire( const Inet_addr& peer );
+  void release( const Inet_addr& peer );
+
+  //! Whether total limit is reached.
+  bool full() const;
+
+  //! Check total limit and remember acceptor if it is reached.
+  /*! Acceptor is resumed (see Acceptor::resume()) by release()
+      which drops number of connections below low watermark.
+      \return whether the limit is reached. */
+  bool pause_if_full( Acceptor* );
+
+  //! Forget acceptor which is going to be destroyed.
+  void cancel_pause( Acceptor* );
+
+  //! Whether number of connections dropped below low watermark.
+  bool below_low_watermark() const;
+
+  //! Current number of connections.
+  size_t count() const;
+
+private:
+  typedef std::map<std::string, size_t> Peer_counts;
+  typedef std::vector<Acceptor*> Acceptors;
+
+  mutable boost::mutex lock;
+  size_t num_conns;
+  size_t max_conns;
+  size_t low_watermark;
+  size_t max_per_ip;
+  Peer_counts peers;
+  Acceptors paused;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+} // namespace iqnet
+
+#endif
@@ -31,6 +31,18 @@ size_t Connection::send( const char* data, size_t len )
 }
 
 
+size_t Connection::send( const Buffer_chain& chain )
+{
+  return sock.send( chain );
+}
+
+
+size_t Connection::send_nonblocking( const Buffer_chain& chain )
+{
+  return sock.send_nonblocking( chain );
+}
+
+
 size_t Connection::recv( char* buf, size_t len )
 {
   return sock.recv( buf, len );
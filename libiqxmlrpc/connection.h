@@ -4,6 +4,7 @@
 #ifndef _libiqnet_connection_h_
 #define _libiqnet_connection_h_
 
+#include "buffer_chain.h"
 #include "inet_addr.h"
 #include "net_except.h"
 #include "reactor.h"
@@ -42,6 +43,10 @@ public:
   }
 
   virtual size_t send( const char*, size_t );
+  //! Gather write of buffer chain, see Socket::send(const Buffer_chain&).
+  size_t send( const Buffer_chain& );
+  //! See Socket::send_nonblocking().
+  size_t send_nonblocking( const Buffer_chain& );
   virtual size_t recv( char*, size_t );
 };
 
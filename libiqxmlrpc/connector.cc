@@ -53,6 +53,16 @@ Connector_base::connect(int timeout)
 {
   Reactor<Null_lock> reactor;
   Connect_processor connector(reactor);
+
+  try {
+    connector.sock.set_options( sock_opts );
+  }
+  catch( ... )
+  {
+    connector.sock.close();
+    throw;
+  }
+
   bool done = connector.sock.connect( peer_addr );
 
   if (done)
@@ -10,11 +10,18 @@ namespace iqnet {
 
 class LIBIQXMLRPC_API Connector_base {
   Inet_addr peer_addr;
+  Socket_options sock_opts;
 
 public:
   Connector_base( const iqnet::Inet_addr& peer );
   virtual ~Connector_base();
 
+  //! Set TCP options applied to socket before connecting.
+  void set_socket_options( const Socket_options& opts )
+  {
+    sock_opts = opts;
+  }
+
   //! Process connection.
   iqxmlrpc::Client_connection* connect(int timeout);
 
@@ -0,0 +1,224 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "config.h"
+#include "content_encoding.h"
+#include "http_errors.h"
+
+#include <boost/algorithm/string.hpp>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace iqxmlrpc {
+namespace http {
+
+namespace {
+
+//! Coding of one Accept-Encoding list element, which is
+//! not acceptable when its quality value is zero.
+bool accepted_coding( const std::string& elem, std::string& name )
+{
+  std::vector<std::string> params;
+  boost::split( params, elem, boost::is_any_of(";") );
+
+  name = boost::to_lower_copy( boost::trim_copy(params[0]) );
+
+  for( size_t i = 1; i < params.size(); ++i )
+  {
+    std::string p = boost::trim_copy( params[i] );
+    if( p.length() < 2 || (p[0] != 'q' && p[0] != 'Q') || p[1] != '=' )
+      continue;
+
+    return p.find_first_not_of( "0.", 2 ) != std::string::npos;
+  }
+
+  return true;
+}
+
+#ifdef HAVE_ZLIB
+const int window_bits = 15;
+const int gzip_window_bits = window_bits + 16;
+const int auto_window_bits = window_bits + 32;
+const size_t chunk_sz = 64 * 1024;
+
+//! \return false if data is not in expected format from the start.
+bool inflate_content( const std::string& in, std::string& out, int bits, size_t max_sz )
+{
+  z_stream zs = z_stream();
+  if( inflateInit2(&zs, bits) != Z_OK )
+    throw Malformed_packet( "can not initialize decompression" );
+
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = static_cast<uInt>(in.length());
+
+  int rc = Z_OK;
+  while( rc == Z_OK )
+  {
+    size_t have = out.length();
+    out.resize( have + chunk_sz );
+
+    zs.next_out = reinterpret_cast<Bytef*>(&out[have]);
+    zs.avail_out = static_cast<uInt>(chunk_sz);
+
+    rc = inflate( &zs, Z_NO_FLUSH );
+    out.resize( have + chunk_sz - zs.avail_out );
+
+    if( max_sz && out.length() > max_sz )
+    {
+      inflateEnd( &zs );
+      throw Request_too_large();
+    }
+  }
+
+  bool started = zs.total_out != 0;
+  inflateEnd( &zs );
+
+  if( rc == Z_STREAM_END )
+    return true;
+
+  if( rc == Z_DATA_ERROR && !started )
+    return false;
+
+  throw Malformed_packet( "corrupted compressed content" );
+}
+#endif
+
+} // anonymous namespace
+
+
+bool content_coding_supported()
+{
+#ifdef HAVE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char* coding_name( Content_coding c )
+{
+  switch( c )
+  {
+    case CODING_GZIP:    return "gzip";
+    case CODING_DEFLATE: return "deflate";
+    default:             return "identity";
+  }
+}
+
+std::string accepted_codings()
+{
+  return content_coding_supported() ? "gzip, deflate" : "identity";
+}
+
+Content_coding parse_coding( const std::string& s )
+{
+  std::string name = boost::to_lower_copy( boost::trim_copy(s) );
+
+  if( name.empty() || name == "identity" )
+    return CODING_IDENTITY;
+
+  if( content_coding_supported() )
+  {
+    if( name == "gzip" || name == "x-gzip" )
+      return CODING_GZIP;
+
+    if( name == "deflate" )
+      return CODING_DEFLATE;
+  }
+
+  throw Unsupported_content_encoding( name );
+}
+
+Content_coding choose_coding( const std::string& accept )
+{
+  if( !content_coding_supported() || accept.empty() )
+    return CODING_IDENTITY;
+
+  std::vector<std::string> elems;
+  boost::split( elems, accept, boost::is_any_of(",") );
+
+  bool deflate = false;
+  for( size_t i = 0; i < elems.size(); ++i )
+  {
+    std::string name;
+    if( !accepted_coding(elems[i], name) )
+      continue;
+
+    if( name == "gzip" || name == "x-gzip" || name == "*" )
+      return CODING_GZIP;
+
+    if( name == "deflate" )
+      deflate = true;
+  }
+
+  return deflate ? CODING_DEFLATE : CODING_IDENTITY;
+}
+
+void encode_content( std::string& s, Content_coding c )
+{
+  if( c == CODING_IDENTITY )
+    return;
+
+#ifdef HAVE_ZLIB
+  z_stream zs = z_stream();
+  int bits = c == CODING_GZIP ? gzip_window_bits : window_bits;
+
+  if( deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+    throw Exception( "Can not initialize compression." );
+
+  std::string out;
+  out.resize( deflateBound(&zs, static_cast<uLong>(s.length())) );
+
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(s.data()));
+  zs.avail_in = static_cast<uInt>(s.length());
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = static_cast<uInt>(out.length());
+
+  int rc = deflate( &zs, Z_FINISH );
+  out.resize( zs.total_out );
+  deflateEnd( &zs );
+
+  if( rc != Z_STREAM_END )
+    throw Exception( "Compression failed." );
+
+  s.swap( out );
+#else
+  throw Unsupported_content_encoding( coding_name(c) );
+#endif
+}
+
+void decode_content( std::string& s, Content_coding c, size_t max_sz )
+{
+  if( c == CODING_IDENTITY )
+    return;
+
+#ifdef HAVE_ZLIB
+  std::string out;
+
+  // Some peers send raw deflate data instead of zlib format.
+  if( !inflate_content(s, out, auto_window_bits, max_sz) )
+  {
+    out.erase();
+    if( c != CODING_DEFLATE || !inflate_content(s, out, -window_bits, max_sz) )
+      throw Malformed_packet( "corrupted compressed content" );
+  }
+
+  s.swap( out );
+#else
+  throw Unsupported_content_encoding( coding_name(c) );
+#endif
+}
+
+size_t max_decoded_sz( size_t encoded_sz )
+{
+  const size_t ratio = 100;
+  const size_t min_limit = 1024 * 1024;
+  return encoded_sz > min_limit / ratio ? encoded_sz * ratio : min_limit;
+}
+
+} // namespace http
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
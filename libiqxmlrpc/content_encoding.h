@@ -0,0 +1,52 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _libiqxmlrpc_content_encoding_h_
+#define _libiqxmlrpc_content_encoding_h_
+
+#include "api_export.h"
+
+#include <string>
+
+namespace iqxmlrpc {
+namespace http {
+
+//! Content codings of HTTP message body.
+enum Content_coding { CODING_IDENTITY, CODING_GZIP, CODING_DEFLATE };
+
+//! Whether library is built with compression support (zlib).
+LIBIQXMLRPC_API bool content_coding_supported();
+
+//! Name of coding to put into Content-Encoding option.
+LIBIQXMLRPC_API const char* coding_name( Content_coding );
+
+//! Value of Accept-Encoding option listing supported codings.
+LIBIQXMLRPC_API std::string accepted_codings();
+
+//! Get coding by Content-Encoding option value.
+/*! Throws Unsupported_content_encoding for unknown codings
+    and for compressed ones when library is built without zlib. */
+LIBIQXMLRPC_API Content_coding parse_coding( const std::string& );
+
+//! Choose the best supported coding listed in Accept-Encoding value.
+LIBIQXMLRPC_API Content_coding choose_coding( const std::string& accept );
+
+//! Compress data in place.
+LIBIQXMLRPC_API void encode_content( std::string&, Content_coding );
+
+//! Decompress data in place.
+/*! \param max_sz Limit of decompressed size, exceeding it causes
+    Request_too_large. Zero means no limit.
+    Throws Malformed_packet when data is corrupted. */
+LIBIQXMLRPC_API void decode_content( std::string&, Content_coding, size_t max_sz = 0 );
+
+//! Limit of decompressed size for data received with no other limit.
+/*! 100 times of compressed size but at least 1 MB, so that small
+    compressed data can not be inflated to exhaust memory. */
+LIBIQXMLRPC_API size_t max_decoded_sz( size_t encoded_sz );
+
+} // namespace http
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
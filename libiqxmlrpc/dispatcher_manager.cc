@@ -5,9 +5,12 @@
 
 #include "builtins.h"
 
+#include <boost/shared_ptr.hpp>
+
 #include <algorithm>
 #include <deque>
 #include <map>
+#include <memory>
 
 namespace iqxmlrpc {
 
@@ -16,12 +19,11 @@ namespace iqxmlrpc {
 //
 
 class Default_method_dispatcher: public Method_dispatcher_base {
-  typedef std::map<std::string, Method_factory_base*> Factory_map;
+  typedef boost::shared_ptr<Method_factory_base> Factory_ptr;
+  typedef std::map<std::string, Factory_ptr> Factory_map;
   Factory_map fs;
 
 public:
-  ~Default_method_dispatcher();
-
   void register_method(const std::string& name, Method_factory_base*);
 
 private:
@@ -32,24 +34,19 @@ private:
   do_get_methods_list(Array&) const;
 };
 
-Default_method_dispatcher::~Default_method_dispatcher()
-{
-  util::delete_ptrs( fs.begin(), fs.end(),
-    util::Select2nd<Factory_map>());
-}
-
 void Default_method_dispatcher::register_method
   ( const std::string& name, Method_factory_base* fb )
 {
-  fs[name] = fb;
+  fs[name] = Factory_ptr(fb);
 }
 
 Method* Default_method_dispatcher::do_create_method(const std::string& name)
 {
-  if( fs.find(name) == fs.end() )
+  Factory_map::const_iterator i = fs.find(name);
+  if( i == fs.end() )
     return NULL;
 
-  return fs[name]->create();
+  return i->second->create();
 }
 
 void Default_method_dispatcher::do_get_methods_list(Array& retval) const
@@ -90,16 +87,23 @@ public:
   typedef std::deque<Method_dispatcher_base*> DispatchersSet;
   DispatchersSet dispatchers;
   Default_method_dispatcher* default_disp;
+  bool introspection;
+  bool own_dispatchers;
 
   Impl():
-    default_disp(new Default_method_dispatcher)
+    default_disp(new Default_method_dispatcher),
+    introspection(false),
+    own_dispatchers(true)
   {
     dispatchers.push_back(default_disp);
   }
 
   ~Impl()
   {
-    util::delete_ptrs(dispatchers.begin(), dispatchers.end());
+    if (own_dispatchers)
+      util::delete_ptrs(dispatchers.begin(), dispatchers.end());
+    else
+      delete default_disp;
   }
 };
 
@@ -147,8 +151,26 @@ void Method_dispatcher_manager::get_methods_list(Array& retval) const
 
 void Method_dispatcher_manager::enable_introspection()
 {
+  impl_->introspection = true;
   impl_->default_disp->register_method("system.listMethods",
     new System_method_factory<builtins::List_methods>(this));
 }
 
+Method_dispatcher_manager* Method_dispatcher_manager::clone() const
+{
+  std::auto_ptr<Method_dispatcher_manager> copy(new Method_dispatcher_manager);
+  Impl* cimpl = copy->impl_;
+
+  *cimpl->default_disp = *impl_->default_disp;
+  cimpl->own_dispatchers = false;
+  cimpl->dispatchers.insert(cimpl->dispatchers.end(),
+    impl_->dispatchers.begin() + 1, impl_->dispatchers.end());
+
+  // Let built-in methods of the copy refer to the copy itself.
+  if (impl_->introspection)
+    copy->enable_introspection();
+
+  return copy.release();
+}
+
 } // namespace iqxmlrpc
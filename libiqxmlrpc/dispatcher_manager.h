@@ -45,6 +45,14 @@ public:
 
   //! Turns on introspection.
   void enable_introspection();
+
+  //! Create a copy with its own default dispatcher.
+  /*! Method factories registered with register_method() are shared
+      with the copy, dispatchers added with push_back() are referenced
+      by the copy and remain owned by this object. So the copy must not
+      outlive the original one.
+   */
+  Method_dispatcher_manager* clone() const;
 };
 
 #ifdef _MSC_VER
@@ -6,6 +6,7 @@
 #include "reactor_impl.h"
 #include "response.h"
 #include "server.h"
+#include "server_conn.h"
 #include "util.h"
 
 #include <memory>
@@ -17,7 +18,9 @@ Executor::Executor( Method* m, Server* s, Server_connection* cb ):
   method(m),
   interceptors(0),
   server(s),
-  conn(cb)
+  conn(cb),
+  reactor(cb ? cb->get_reactor() : 0),
+  seq(cb ? cb->dispatched_request() : 0)
 {
 }
 
@@ -36,7 +39,9 @@ void Executor::schedule_response( const Response& resp )
 
 void Executor::interrupt_server()
 {
-  server->interrupt();
+  // Connection may be already destroyed here,
+  // so wake up the reactor it was served by.
+  server->interrupt(reactor);
 }
 
 // ----------------------------------------------------------------------------
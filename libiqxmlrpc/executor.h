@@ -58,6 +58,8 @@ protected:
 private:
   Server* server;
   Server_connection* conn;
+  iqnet::Reactor_base* reactor;
+  unsigned seq;
 
 public:
   Executor( Method*, Server*, Server_connection* );
@@ -65,6 +67,9 @@ public:
 
   void set_interceptors(Interceptor* ic) { interceptors = ic; }
 
+  //! Number of connection's request being executed.
+  unsigned request_seq() const { return seq; }
+
   //! Start method execution.
   virtual void execute( const Param_list& params ) = 0;
 
@@ -5,6 +5,7 @@
 
 #include "http_errors.h"
 #include "method.h"
+#include "reactor.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
@@ -13,8 +14,10 @@
 #include <boost/optional.hpp>
 
 #include <algorithm>
-#include <deque>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <map>
 #include <memory>
 #include <sstream>
 
@@ -32,139 +35,344 @@ namespace names {
   const char date[]           = "date";
   const char authorization[]  = "authorization";
   const char expect_continue[]= "expect";
+  const char content_encoding[]= "content-encoding";
+  const char accept_encoding[] = "accept-encoding";
+  const char transfer_encoding[] = "transfer-encoding";
 } // namespace names
 
 
-namespace validator {
+namespace {
+
+inline char lower(char c)
+{
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+//! Case insensitive comparison with lower case string.
+bool iequals(const char* s, size_t len, const char* lower_str)
+{
+  size_t i = 0;
+  for (; i < len && lower_str[i]; ++i)
+    if (lower(s[i]) != lower_str[i])
+      return false;
+
+  return i == len && !lower_str[i];
+}
 
-void unsigned_number(const std::string& val)
+//! Case insensitive search of lower case string.
+bool icontains(const char* s, size_t len, const char* lower_str)
 {
-  const char errmsg[] = "bad format of numeric option";
+  size_t sub_len = strlen(lower_str);
 
-  try {
-    if (!boost::all(val, boost::is_digit()))
-      throw Malformed_packet(errmsg);
+  for (size_t i = 0; i + sub_len <= len; ++i)
+    if (iequals(s + i, sub_len, lower_str))
+      return true;
 
-    boost::lexical_cast<unsigned>(val);
-  } catch (const boost::bad_lexical_cast&) {
-    throw Malformed_packet(errmsg);
+  return false;
+}
+
+//! \return false if string is not a number or does not fit unsigned.
+bool to_unsigned(const char* s, size_t len, unsigned& val)
+{
+  if (!len)
+    return false;
+
+  const unsigned max = std::numeric_limits<unsigned>::max();
+  val = 0;
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (s[i] < '0' || s[i] > '9')
+      return false;
+
+    unsigned d = static_cast<unsigned>(s[i] - '0');
+    if (val > (max - d) / 10)
+      return false;
+
+    val = val * 10 + d;
   }
+
+  return true;
 }
 
-void content_type(const std::string& val)
+} // anonymous namespace
+
+
+namespace validator {
+
+void unsigned_number(const char* val, size_t len)
 {
-  std::string cont_type(val);
-  boost::to_lower(cont_type);
+  unsigned tmp;
+  if (!to_unsigned(val, len, tmp))
+    throw Malformed_packet("bad format of numeric option");
+}
 
-  if (!boost::find_first(cont_type, "text/xml"))
-    throw Unsupported_content_type(cont_type);
+void content_type(const char* val, size_t len)
+{
+  if (!icontains(val, len, "text/xml"))
+    throw Unsupported_content_type(boost::to_lower_copy(std::string(val, len)));
 }
 
-void expect_continue(const std::string& val)
+void expect_continue(const char* val, size_t len)
 {
-  std::string exp(val);
-  boost::to_lower(exp);
+  const char exp[] = "100-continue";
+  size_t exp_len = sizeof(exp) - 1;
 
-  if (!boost::starts_with(exp, "100-continue"))
+  if (len < exp_len || !iequals(val, exp_len, exp))
     throw Expectation_failed();
 }
 
 } // namespace validator
 
 
+namespace {
+
+typedef void (*Option_validator_fn)(const char*, size_t);
+
+struct Known_option_info {
+  const char*         name;
+  Option_validator_fn validate;
+  Verification_level  level;
+};
+
+//! Options having dedicated slots in Header, in order of Known_option.
+const Known_option_info known_options[] = {
+  { names::content_length,  validator::unsigned_number, HTTP_CHECK_WEAK },
+  { names::content_type,    validator::content_type,    HTTP_CHECK_STRICT },
+  { names::connection,      0,                          HTTP_CHECK_WEAK },
+  { names::expect_continue, validator::expect_continue, HTTP_CHECK_WEAK },
+  { names::authorization,   0,                          HTTP_CHECK_WEAK },
+  { names::host,            0,                          HTTP_CHECK_WEAK },
+  { names::user_agent,      0,                          HTTP_CHECK_WEAK },
+  { names::server,          0,                          HTTP_CHECK_WEAK },
+  { names::date,            0,                          HTTP_CHECK_WEAK },
+  { names::content_encoding, 0,                         HTTP_CHECK_WEAK },
+  { names::accept_encoding, 0,                          HTTP_CHECK_WEAK },
+  { names::transfer_encoding, 0,                        HTTP_CHECK_WEAK }
+};
+
+const size_t num_known_options = sizeof(known_options) / sizeof(known_options[0]);
+
+//! \return index in known_options or num_known_options.
+size_t find_known(const char* name, size_t len)
+{
+  for (size_t i = 0; i < num_known_options; ++i)
+    if (iequals(name, len, known_options[i].name))
+      return i;
+
+  return num_known_options;
+}
+
+} // anonymous namespace
+
+
 Header::Header(Verification_level lev):
-  ver_level_(lev)
+  num_options_(0),
+  ver_level_(lev),
+  keep_alive_default_(false)
 {
-  set_option_default(names::connection, "close");
-  register_validator(names::content_length, validator::unsigned_number, HTTP_CHECK_WEAK);
-  register_validator(names::expect_continue, validator::expect_continue, HTTP_CHECK_WEAK);
-  register_validator(names::content_type, validator::content_type, HTTP_CHECK_STRICT);
 }
 
 Header::~Header()
 {
 }
 
-void Header::register_validator(
-  const std::string& name,
-  Header::Option_validator_fn fn,
-  Verification_level level)
+void Header::parse(std::string& s)
 {
-  Option_validator v = { level, fn };
-  validators_.insert(std::make_pair(name, v));
+  text_.erase();
+  text_.swap(s);
+
+  char* text = text_.empty() ? 0 : &text_[0];
+  const char* end = text + text_.length();
+  bool head_read = false;
+
+  for (char* line = text; line < end;)
+  {
+    char* eol = static_cast<char*>(memchr(line, '\n', end - line));
+    if (!eol)
+      eol = text + text_.length();
+
+    char* next = eol + 1;
+    while (eol > line && is_space(eol[-1]))
+      --eol;
+
+    if (eol == line) {
+      line = next;
+      continue;
+    }
+
+    if (!head_read) {
+      head_line_ = Slice(line - text, eol - line);
+      head_read = true;
+      line = next;
+      continue;
+    }
+
+    char* colon = static_cast<char*>(memchr(line, ':', eol - line));
+    if (!colon)
+      throw Malformed_packet("option line does not contain a colon symbol");
+
+    char* name = line;
+    char* name_end = colon;
+    while (name < name_end && is_space(*name))
+      ++name;
+    while (name_end > name && is_space(name_end[-1]))
+      --name_end;
+
+    const char* val = colon + 1;
+    while (val < eol && is_space(*val))
+      ++val;
+
+    for (char* c = name; c < name_end; ++c)
+      *c = lower(*c);
+
+    size_t name_len = name_end - name;
+    size_t val_len = eol - val;
+    size_t k = find_known(name, name_len);
+
+    Slice value(val - text, val_len);
+
+    if (k < num_known_options) {
+      const Known_option_info& info = known_options[k];
+      if (info.validate && info.level <= ver_level_)
+        info.validate(val, val_len);
+
+      known_[k] = value;
+    } else {
+      set_value(name, name_len, value);
+    }
+    line = next;
+  }
+}
+
+Header::Slice Header::append_text(const std::string& s)
+{
+  Slice r(text_.length(), s.length());
+  text_ += s;
+  return r;
 }
 
-void Header::parse(const std::string& s)
+size_t Header::find_option(const char* name, size_t len) const
 {
-  typedef std::deque<std::string> Tokens;
-  Tokens lines;
-  boost::split(lines, s, boost::is_any_of(names::crlf), boost::token_compress_on);
+  for (size_t i = 0; i < num_options_; ++i)
+  {
+    const Slice& n = option(i).name;
+    if (n.len != len)
+      continue;
+
+    size_t j = 0;
+    while (j < len && lower(text_[n.pos + j]) == lower(name[j]))
+      ++j;
 
-  if (!lines.empty()) {
-    head_line_ = lines.front();
-    lines.pop_front();
+    if (j == len)
+      return i;
   }
 
-  for (Tokens::iterator i = lines.begin(); i != lines.end(); ++i) {
-    boost::iterator_range<std::string::iterator> j = boost::find_first(*i, ":");
-    if (j.begin() == i->end())
-      throw Malformed_packet("option line does not contain a colon symbol");
+  return npos;
+}
 
-    std::string opt_name, opt_value;
-    std::copy(i->begin(), j.begin(), std::back_inserter(opt_name));
-    std::copy(j.end(), i->end(), std::back_inserter(opt_value));
+const Header::Slice* Header::find_value(const std::string& name) const
+{
+  size_t k = find_known(name.data(), name.length());
+  if (k < num_known_options)
+    return known_[k].pos != npos ? &known_[k] : 0;
 
-    boost::trim(opt_name);
-    boost::trim(opt_value);
-    boost::to_lower(opt_name);
-    set_option_checked(opt_name, opt_value);
-  }
+  size_t i = find_option(name.data(), name.length());
+  return i != npos ? &option(i).value : 0;
 }
 
-template <class T>
-T Header::get_option(const std::string& name) const
+void Header::set_value(const char* name, size_t len, const Slice& value)
 {
-  Options::const_iterator i = options_.find(name);
+  size_t k = find_known(name, len);
+  if (k < num_known_options) {
+    known_[k] = value;
+    return;
+  }
 
-  if (i == options_.end()) {
-      throw Malformed_packet("Missing mandatory header option '" + name + "'.");
+  size_t i = find_option(name, len);
+  if (i != npos) {
+    option(i).value = value;
+    return;
   }
 
-  try {
-    return boost::lexical_cast<T>(i->second);
-  } catch (boost::bad_lexical_cast&) {
-    throw Malformed_packet("Header option '" + name + "' has wrong format.");
+  Option opt;
+  opt.name = text_.data() <= name && name < text_.data() + text_.length() ?
+    slice(name, len) : append_text(std::string(name, len));
+  opt.value = value;
+
+  if (num_options_ < INLINE_OPTIONS)
+    inline_options_[num_options_] = opt;
+  else
+    options_.push_back(opt);
+
+  num_options_++;
+}
+
+void Header::replace_value(Slice& v, const std::string& s)
+{
+  if (s.length() <= v.len) {
+    text_.replace(v.pos, s.length(), s);
+    v.len = s.length();
+    return;
   }
+
+  // Value at the end of text grows in place.
+  if (v.pos + v.len == text_.length())
+    text_.erase(v.pos);
+
+  v = append_text(s);
+}
+
+bool Header::value_is(Known_option k, const char* lower_str) const
+{
+  const Slice& v = known_[k];
+  return v.pos != npos && iequals(text_.data() + v.pos, v.len, lower_str);
 }
 
 std::string Header::get_string(const std::string& name) const
 {
-  return get_option<std::string>(name);
+  const Slice* v = find_value(name);
+
+  if (!v)
+    throw Malformed_packet("Missing mandatory header option '" + name + "'.");
+
+  return text(*v);
 }
 
-unsigned Header::get_unsigned(const std::string& name) const
+std::string Header::get_string(Known_option k) const
 {
-  return get_option<unsigned>(name);
+  return get_string(known_options[k].name);
 }
 
-inline
-void Header::set_option_checked(const std::string& name, const std::string& value)
+unsigned Header::get_unsigned(const std::string& name) const
 {
-  std::pair<Validators::const_iterator, Validators::const_iterator> v =
-    validators_.equal_range(name);
+  const Slice* v = find_value(name);
 
-  for (Validators::const_iterator i = v.first; i != v.second; ++i)
-  {
-    if (i->second.level <= ver_level_)
-      i->second.fn(value);
-  }
+  if (!v)
+    throw Malformed_packet("Missing mandatory header option '" + name + "'.");
 
-  set_option(name, value);
+  unsigned val = 0;
+  if (!to_unsigned(text_.data() + v->pos, v->len, val))
+    throw Malformed_packet("Header option '" + name + "' has wrong format.");
+
+  return val;
 }
 
 void Header::set_option(const std::string& name, const std::string& value)
 {
-  options_[name] = value;
+  Slice* v = const_cast<Slice*>(find_value(name));
+  if (v) {
+    replace_value(*v, value);
+    return;
+  }
+
+  Slice nv = append_text(value);
+  set_value(name.data(), name.length(), nv);
 }
 
 void Header::set_option(const std::string& name, size_t value)
@@ -174,7 +382,7 @@ void Header::set_option(const std::string& name, size_t value)
 
 bool Header::option_exists(const std::string& name) const
 {
-  return options_.find(name) != options_.end();
+  return find_value(name) != 0;
 }
 
 void Header::set_option_default(const std::string& name, const std::string& value)
@@ -188,9 +396,31 @@ void Header::set_option_default(const std::string& name, const std::string& valu
 std::string Header::dump() const
 {
   std::string retval = dump_head();
+  retval.reserve(retval.length() + text_.length() + 256);
+
+  if (!option_exists(CONNECTION)) {
+    retval += names::connection;
+    retval += keep_alive_default_ ? ": keep-alive" : ": close";
+    retval += names::crlf;
+  }
+
+  for (size_t k = 0; k < num_known_options; ++k) {
+    const Slice& v = known_[k];
+    if (v.pos == npos)
+      continue;
 
-  for (Options::const_iterator i = options_.begin(); i != options_.end(); ++i) {
-    retval += i->first + ": " + i->second + names::crlf;
+    retval += known_options[k].name;
+    retval += ": ";
+    retval.append(text_, v.pos, v.len);
+    retval += names::crlf;
+  }
+
+  for (size_t i = 0; i < num_options_; ++i) {
+    const Option& o = option(i);
+    retval.append(text_, o.name.pos, o.name.len);
+    retval += ": ";
+    retval.append(text_, o.value.pos, o.value.len);
+    retval += names::crlf;
   }
 
   retval += names::crlf;
@@ -199,9 +429,16 @@ std::string Header::dump() const
 
 void Header::set_content_length(size_t len)
 {
-  set_option(names::content_length, len);
+  // Parsed header is usually passed with the same length.
+  unsigned cur = 0;
+  const Slice& v = known_[CONTENT_LENGTH];
+  bool same = v.pos != npos &&
+    to_unsigned(text_.data() + v.pos, v.len, cur) && cur == len;
+
+  if (!same)
+    set_option(names::content_length, len);
 
-  if (len)
+  if (len && !option_exists(CONTENT_TYPE))
     set_option(names::content_type, "text/xml");
 }
 
@@ -210,9 +447,14 @@ void Header::set_conn_keep_alive(bool c)
   set_option(names::connection, c ? "keep-alive" : "close");
 }
 
+void Header::set_expect_continue()
+{
+  set_option(names::expect_continue, "100-continue");
+}
+
 unsigned Header::content_length() const
 {
-  if (!option_exists(names::content_length))
+  if (!option_exists(CONTENT_LENGTH))
     throw Length_required();
 
   return get_unsigned(names::content_length);
@@ -220,44 +462,135 @@ unsigned Header::content_length() const
 
 bool Header::conn_keep_alive() const
 {
-  return get_string(names::connection) == "keep-alive";
+  if (!option_exists(CONNECTION))
+    return keep_alive_default_;
+
+  return value_is(CONNECTION, "keep-alive");
 }
 
 bool Header::expect_continue() const
 {
-  return option_exists(names::expect_continue);
+  return option_exists(EXPECT);
+}
+
+std::string Header::content_encoding() const
+{
+  return option_exists(CONTENT_ENCODING) ? get_string(CONTENT_ENCODING) : std::string();
+}
+
+bool Header::chunked() const
+{
+  const Slice& v = known_[TRANSFER_ENCODING];
+  return v.pos != npos && icontains(text_.data() + v.pos, v.len, "chunked");
+}
+
+void Header::set_chunked(bool c)
+{
+  if (c) {
+    set_option(names::transfer_encoding, "chunked");
+    known_[CONTENT_LENGTH] = Slice();
+
+    if (!option_exists(CONTENT_TYPE))
+      set_option(names::content_type, "text/xml");
+  } else {
+    known_[TRANSFER_ENCODING] = Slice();
+  }
+}
+
+void Header::set_content_encoding(const std::string& enc)
+{
+  if (enc.empty())
+    known_[CONTENT_ENCODING] = Slice();
+  else
+    set_option(names::content_encoding, enc);
+}
+
+void Header::get_xheaders(iqxmlrpc::XHeaders& xheaders) const
+{
+  std::map<std::string, std::string> opts;
+
+  for (size_t i = 0; i < num_options_; ++i) {
+    const Option& o = option(i);
+    if (o.name.len < 2 || lower(text_[o.name.pos]) != 'x' || text_[o.name.pos + 1] != '-')
+      continue;
+
+    opts[text(o.name)] = text(o.value);
+  }
+
+  xheaders = opts;
+}
+
+void Header::set_xheaders(const iqxmlrpc::XHeaders& xheaders)
+{
+  for( iqxmlrpc::XHeaders::const_iterator it = xheaders.begin(); it!=xheaders.end(); ++it ) {
+    set_option(it->first, it->second);
+  }
+}
+
+namespace {
+
+//! Find next space separated word of the line.
+bool next_word(const char*& p, const char* end, const char*& word, size_t& len)
+{
+  while (p < end && is_space(*p))
+    ++p;
+
+  word = p;
+  while (p < end && !is_space(*p))
+    ++p;
+
+  len = p - word;
+  return len != 0;
 }
 
+} // anonymous namespace
+
 // ----------------------------------------------------------------------------
 Request_header::Request_header(Verification_level lev, const std::string& to_parse):
   Header(lev)
 {
-  parse(to_parse);
-  set_option_default(names::host, "");
-  set_option_default(names::user_agent, "unknown");
+  std::string s(to_parse);
+  parse(s);
+  parse_head();
+}
+
+Request_header::Request_header(Verification_level lev, std::string* to_parse):
+  Header(lev)
+{
+  parse(*to_parse);
+  parse_head();
+}
 
+void Request_header::parse_head()
+{
   // parse method
-  typedef std::deque<std::string> Token;
-  Token method_line;
-  boost::split(method_line, get_head_line(), boost::is_space(), boost::token_compress_on);
+  const char* p = head_line();
+  const char* end = p + head_line_length();
+  const char* word = 0;
+  size_t len = 0;
 
-  if (method_line.empty())
+  if (!next_word(p, end, word, len))
     throw Bad_request();
 
-  if( method_line[0] != "POST" )
+  if (len != 4 || strncmp(word, "POST", 4))
     throw Method_not_allowed();
 
-  if (method_line.size() > 1)
-    uri_ = method_line[1];
+  if (next_word(p, end, word, len))
+    uri_ = slice(word, len);
+
+  if (next_word(p, end, word, len)) {
+    version_ = slice(word, len);
+    set_keep_alive_default(len == 8 && !strncmp(word, "HTTP/1.1", 8));
+  }
 }
 
 Request_header::Request_header(
   const std::string& req_uri,
   const std::string& vhost,
   int port
-):
-  uri_(req_uri)
+)
 {
+  uri_ = append_text(req_uri);
   std::ostringstream host_opt;
   host_opt << vhost << ":" << port;
   set_option(names::host, host_opt.str());
@@ -266,34 +599,37 @@ Request_header::Request_header(
 
 std::string Request_header::dump_head() const
 {
-  return "POST " + uri() + " HTTP/1.0" + names::crlf;
+  return "POST " + uri() + " HTTP/1.1" + names::crlf;
 }
 
 std::string Request_header::host() const
 {
-  return get_string(names::host);
+  return option_exists(HOST) ? get_string(HOST) : std::string();
 }
 
 std::string Request_header::agent() const
 {
-  return get_string(names::user_agent);
+  return option_exists(USER_AGENT) ? get_string(USER_AGENT) : "unknown";
 }
 
-void Header::get_xheaders(iqxmlrpc::XHeaders& xheaders) const
+std::string Request_header::accept_encoding() const
 {
-  xheaders = options_;
+  return option_exists(ACCEPT_ENCODING) ? get_string(ACCEPT_ENCODING) : std::string();
 }
 
-void Header::set_xheaders(const iqxmlrpc::XHeaders& xheaders)
+void Request_header::set_accept_encoding(const std::string& enc)
 {
-  for( iqxmlrpc::XHeaders::const_iterator it = xheaders.begin(); it!=xheaders.end(); ++it ) {
-    set_option(it->first, it->second);
-  }
+  set_option(names::accept_encoding, enc);
 }
 
 bool Request_header::has_authinfo() const
 {
-  return option_exists(names::authorization);
+  return option_exists(AUTHORIZATION);
+}
+
+std::string Request_header::raw_authinfo() const
+{
+  return get_string(AUTHORIZATION);
 }
 
 void Request_header::get_authinfo(std::string& user, std::string& pw) const
@@ -302,7 +638,7 @@ void Request_header::get_authinfo(std::string& user, std::string& pw) const
     throw Unauthorized();
 
   std::vector<std::string> v;
-  std::string authstring = get_string(names::authorization);
+  std::string authstring = get_string(AUTHORIZATION);
   boost::split(v, authstring, boost::is_any_of(" \t"));
 
   if (v.size() != 2)
@@ -332,31 +668,48 @@ void Request_header::set_authinfo(const std::string& u, const std::string& p)
 Response_header::Response_header(Verification_level lev, const std::string& to_parse):
   Header(lev)
 {
-  parse(to_parse);
-  set_option_default(names::server, "unknown");
+  std::string s(to_parse);
+  parse(s);
+  parse_head();
+}
+
+Response_header::Response_header(Verification_level lev, std::string* to_parse):
+  Header(lev)
+{
+  parse(*to_parse);
+  parse_head();
+}
 
-  typedef std::deque<std::string> Token;
-  Token resp_line;
-  boost::split(resp_line, get_head_line(), boost::is_space(), boost::token_compress_on);
+void Response_header::parse_head()
+{
+  const char* p = head_line();
+  const char* end = p + head_line_length();
+  const char* word = 0;
+  size_t len = 0;
 
-  if (resp_line.size() < 2) {
+  if (!next_word(p, end, word, len))
     throw Malformed_packet("Bad response");
-  }
 
-  try {
-    code_ = boost::lexical_cast<int>(resp_line[1]);
-  } catch (const boost::bad_lexical_cast&) {
-    code_ = 0;
-  }
+  set_keep_alive_default(len == 8 && !strncmp(word, "HTTP/1.1", 8));
+
+  if (!next_word(p, end, word, len))
+    throw Malformed_packet("Bad response");
+
+  unsigned code = 0;
+  code_ = to_unsigned(word, len, code) ? static_cast<int>(code) : 0;
+
+  if (next_word(p, end, word, len))
+    phrase_ = slice(word, end - word);
 
-  if (resp_line.size() > 2)
-    phrase_ = resp_line[2];
+  // Interim responses never have content.
+  if (code_ >= 100 && code_ < 200 && !option_exists(CONTENT_LENGTH))
+    set_option(names::content_length, size_t(0));
 }
 
 Response_header::Response_header( int c, const std::string& p ):
-  code_(c),
-  phrase_(p)
+  code_(c)
 {
+  phrase_ = append_text(p);
   set_option(names::date, current_date());
   set_option(names::server, PACKAGE " " VERSION);
 }
@@ -384,7 +737,7 @@ std::string Response_header::dump_head() const
 
 std::string Response_header::server() const
 {
-  return get_string(names::server);
+  return option_exists(SERVER) ? get_string(SERVER) : "unknown";
 }
 
 // ---------------------------------------------------------------------------
@@ -395,23 +748,179 @@ Packet::Packet( Header* h, const std::string& co ):
   header_->set_content_length(content_.length());
 }
 
+Packet::Packet( Header* h ):
+  header_(h)
+{
+}
+
 Packet::~Packet()
 {
 }
 
+void Packet::swap_content( std::string& s )
+{
+  content_.swap( s );
+  header_->set_content_length( content_.length() );
+}
+
+namespace {
+
+bool empty_part( const std::string& s )
+{
+  return s.empty();
+}
+
+} // anonymous namespace
+
+void Packet::swap_chunks( std::vector<std::string>& parts )
+{
+  // Empty chunk would terminate content.
+  parts.erase( std::remove_if( parts.begin(), parts.end(), empty_part ), parts.end() );
+
+  if( parts.size() < 2 )
+  {
+    std::string s;
+    if( !parts.empty() )
+      s.swap( parts[0] );
+
+    parts.clear();
+    swap_content( s );
+    return;
+  }
+
+  content_.erase();
+  chunks_.swap( parts );
+  parts.clear();
+
+  header_->set_chunked( true );
+}
+
+void Packet::join_chunks()
+{
+  if( chunks_.empty() )
+    return;
+
+  size_t sz = 0;
+  for( size_t i = 0; i < chunks_.size(); ++i )
+    sz += chunks_[i].length();
+
+  std::string s;
+  s.reserve( sz );
+  for( size_t i = 0; i < chunks_.size(); ++i )
+    s += chunks_[i];
+
+  std::vector<std::string>().swap( chunks_ );
+  header_->set_chunked( false );
+  swap_content( s );
+}
+
+namespace {
+
+//! Line which precedes chunk data, also ends previous chunk if any.
+std::string chunk_head( size_t sz, bool first )
+{
+  std::ostringstream ss;
+  if( !first )
+    ss << names::crlf;
+
+  ss << std::hex << sz << names::crlf;
+  if( !sz )
+    ss << names::crlf;
+
+  return ss.str();
+}
+
+} // anonymous namespace
+
+std::string Packet::dump() const
+{
+  std::string retval( header_->dump() );
+
+  if( chunks_.empty() )
+    return retval + content_;
+
+  for( size_t i = 0; i < chunks_.size(); ++i )
+    retval += chunk_head( chunks_[i].length(), !i ) + chunks_[i];
+
+  return retval + chunk_head( 0, false );
+}
+
+void Packet::dump_to( iqnet::Buffer_chain& out )
+{
+  std::string head( header_->dump() );
+  out.append( head );
+
+  if( chunks_.empty() )
+  {
+    out.append( content_ );
+    return;
+  }
+
+  for( size_t i = 0; i < chunks_.size(); ++i )
+    dump_chunk_to( out, chunks_[i], !i );
+
+  std::string last;
+  dump_chunk_to( out, last, false );
+  chunks_.clear();
+}
+
+void Packet::dump_chunk_to( iqnet::Buffer_chain& out, std::string& data, bool first )
+{
+  std::string size_line( chunk_head(data.length(), first) );
+  out.append( size_line );
+  out.append( data );
+}
+
+void Packet::encode_content( Content_coding c )
+{
+  if( c == CODING_IDENTITY )
+    return;
+
+  join_chunks();
+
+  http::encode_content( content_, c );
+  header_->set_content_encoding( coding_name(c) );
+  header_->set_content_length( content_.length() );
+}
+
+void Packet::decode_content( size_t max_sz )
+{
+  Content_coding c = parse_coding( header_->content_encoding() );
+  if( c == CODING_IDENTITY )
+    return;
+
+  http::decode_content( content_, c, max_sz );
+  header_->set_content_encoding( std::string() );
+  header_->set_content_length( content_.length() );
+}
+
 void Packet::set_keep_alive( bool keep_alive )
 {
   header_->set_conn_keep_alive( keep_alive );
 }
 
+void Packet::set_expect_continue()
+{
+  header_->set_expect_continue();
+}
+
 // ---------------------------------------------------------------------------
 void Packet_reader::clear()
 {
   header = 0;
   content_cache.erase();
   header_cache.erase();
+  // Data which followed previous packet starts the next one.
+  header_cache.swap( pending );
   constructed = false;
-  total_sz = 0;
+  continue_sent_ = false;
+  total_sz = header_cache.length();
+  header_sz = 0;
+  scan_pos = 0;
+  chunk_state = CHUNK_SIZE;
+  chunk_left = 0;
+  decoded_sz = 0;
+  taken_sz = 0;
 }
 
 void Packet_reader::check_sz( size_t sz )
@@ -419,8 +928,8 @@ void Packet_reader::check_sz( size_t sz )
   if( !pkt_max_sz )
     return;
 
-  if (header) {
-    if (header->content_length() + header_cache.length() >= pkt_max_sz)
+  if (header && !header->chunked()) {
+    if (header->content_length() + header_sz >= pkt_max_sz)
       throw Request_too_large();
   }
 
@@ -428,64 +937,260 @@ void Packet_reader::check_sz( size_t sz )
     throw Request_too_large();
 }
 
-bool Packet_reader::read_header( const std::string& s )
+bool Packet_reader::read_header( const char* s, size_t len )
 {
-  using boost::iterator_range;
-  using boost::find_first;
+  if( len )
+    header_cache.append( s, len );
 
-  header_cache += s;
-  iterator_range<std::string::iterator> i = find_first(header_cache, "\r\n\r\n");
+  // Header ends with an empty line, either CRLF or bare LF one.
+  // Scanning continues from where previous chunk stopped.
+  const char* buf = header_cache.data();
+  size_t end = header_cache.length();
 
-  if( i.begin() == i.end() )
-    i = boost::find_first(header_cache, "\n\n");
+  for( size_t i = scan_pos; i < end; ++i )
+  {
+    if( buf[i] != '\n' )
+      continue;
 
-  if( i.begin() == i.end() )
-    return false;
+    size_t next = i + 1;
+    if( next < end && buf[next] == '\r' )
+      next++;
 
-  std::string tmp;
-  std::copy(header_cache.begin(), i.begin(), std::back_inserter(tmp));
-  std::copy(i.end(), header_cache.end(), std::back_inserter(content_cache));
-  header_cache = tmp;
-  return true;
+    if( next >= end )
+    {
+      // Can't tell yet whether the line is empty.
+      scan_pos = i;
+      return false;
+    }
+
+    if( buf[next] != '\n' )
+      continue;
+
+    content_cache.assign( header_cache, next + 1, std::string::npos );
+    header_cache.erase( i );
+    scan_pos = 0;
+    return true;
+  }
+
+  scan_pos = end;
+  return false;
+}
+
+namespace {
+
+//! Limit of content buffer reserved before the data arrives.
+const size_t max_reserve = 4 * iqnet::Reactor_base::read_buffer_sz;
+
+} // anonymous namespace
+
+//! Content is read in one buffer allocated as soon as its length is known.
+void Packet_reader::reserve_content()
+{
+  // Size of chunked content is not known in advance.
+  if( header->chunked() )
+    return;
+
+  size_t len = header->content_length();
+
+  if( pkt_max_sz && len + header_sz >= pkt_max_sz )
+    throw Request_too_large();
+
+  // Content-Length comes from peer, so only a few reads are reserved
+  // until the data actually arrives (see append_content()).
+  content_cache.reserve( std::min( len, max_reserve ) );
+}
+
+void Packet_reader::append_content( const char* s, size_t len )
+{
+  size_t need = content_cache.length() + len;
+
+  if( need > content_cache.capacity() )
+  {
+    size_t cap = std::max( need, 2 * content_cache.capacity() );
+
+    // Buffer does not grow past declared content.
+    if( !header->chunked() )
+      cap = std::max( need, std::min( cap, size_t(header->content_length() - taken_sz) ) );
+
+    content_cache.reserve( cap );
+  }
+
+  content_cache.append( s, len );
+}
+
+namespace {
+
+//! \return false if line does not start with a hex number.
+bool parse_chunk_size( const char* s, size_t len, size_t& sz )
+{
+  const size_t max = std::numeric_limits<size_t>::max();
+  size_t i = 0;
+  sz = 0;
+
+  for( ; i < len; ++i )
+  {
+    char c = lower( s[i] );
+    size_t d = 0;
+
+    if( c >= '0' && c <= '9' )
+      d = c - '0';
+    else if( c >= 'a' && c <= 'f' )
+      d = c - 'a' + 10;
+    else
+      break;
+
+    if( sz > (max - d) / 16 )
+      return false;
+
+    sz = sz * 16 + d;
+  }
+
+  // Chunk extensions are ignored.
+  return i > 0 && (i == len || s[i] == ';' || is_space(s[i]));
+}
+
+} // anonymous namespace
+
+bool Packet_reader::decode_chunks()
+{
+  // Size line (with extensions) or trailer line can not be longer.
+  const size_t max_line = 4096;
+
+  char* buf = content_cache.empty() ? 0 : &content_cache[0];
+  size_t end = content_cache.length();
+  size_t pos = decoded_sz;
+
+  while( pos < end )
+  {
+    if( chunk_state == CHUNK_DATA )
+    {
+      size_t n = std::min( chunk_left, end - pos );
+      memmove( buf + decoded_sz, buf + pos, n );
+      decoded_sz += n;
+      pos += n;
+
+      if( !(chunk_left -= n) )
+        chunk_state = CHUNK_END;
+
+      continue;
+    }
+
+    const char* eol = static_cast<const char*>(memchr( buf + pos, '\n', end - pos ));
+    if( !eol )
+    {
+      if( end - pos > max_line )
+        throw Malformed_packet( "chunk line is too long" );
+
+      break;
+    }
+
+    size_t next = eol - buf + 1;
+    size_t len = next - 1 - pos;
+    if( len && buf[pos + len - 1] == '\r' )
+      --len;
+
+    switch( chunk_state )
+    {
+      case CHUNK_SIZE:
+        if( !parse_chunk_size( buf + pos, len, chunk_left ) )
+          throw Malformed_packet( "bad chunk size" );
+
+        if( pkt_max_sz && chunk_left >= pkt_max_sz - taken_sz - decoded_sz )
+          throw Request_too_large();
+
+        chunk_state = chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+        break;
+
+      case CHUNK_END:
+        if( len )
+          throw Malformed_packet( "chunk is not terminated" );
+
+        chunk_state = CHUNK_SIZE;
+        break;
+
+      case CHUNK_TRAILER:
+        // Trailer options are ignored, empty line ends the content.
+        if( !len )
+        {
+          if( next < end )
+            pending.assign( content_cache, next, std::string::npos );
+
+          content_cache.resize( decoded_sz );
+          return true;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    pos = next;
+  }
+
+  // Keep only decoded data and incomplete line or chunk.
+  content_cache.erase( decoded_sz, pos - decoded_sz );
+  return false;
 }
 
 template <class Header_type>
-Packet* Packet_reader::read_packet( const std::string& s, bool hdr_only )
+Packet* Packet_reader::read_packet( const char* s, size_t len, bool hdr_only )
 {
   if( constructed )
     clear();
 
-  check_sz( s.length() );
+  check_sz( len );
 
   if( !header )
   {
-    if( s.empty() )
+    if( !len && header_cache.empty() )
       throw http::Malformed_packet();
 
-    if (read_header(s))
-      header = new Header_type(ver_level_, header_cache);
+    if (read_header(s, len))
+    {
+      header_sz = header_cache.length();
+      header = new Header_type(ver_level_, &header_cache);
+
+      if( !hdr_only )
+        reserve_content();
+    }
   }
   else
-    content_cache += s;
+    append_content( s, len );
 
   if( header )
   {
     if ( hdr_only )
     {
       constructed = true;
-      return new Packet( header, std::string() );
+      return new Packet( header );
     }
 
-    bool ready = (header->content_length() == 0 && s.empty()) ||
-                 content_cache.length() >= header->content_length();
+    if( header->chunked() )
+    {
+      if( !decode_chunks() )
+        return 0;
 
-    if( ready )
+      // Decoded content goes on with Content-Length.
+      header->set_chunked( false );
+    }
+    else
     {
-      content_cache.erase( header->content_length(), std::string::npos );
-      Packet* packet = new Packet( header, content_cache );
-      constructed = true;
-      return packet;
+      size_t content_len = header->content_length() - taken_sz;
+
+      if( content_cache.length() < content_len )
+        return 0;
+
+      if( content_cache.length() > content_len )
+      {
+        pending.assign( content_cache, content_len, std::string::npos );
+        content_cache.erase( content_len, std::string::npos );
+      }
     }
+
+    Packet* packet = new Packet( header );
+    packet->swap_content( content_cache );
+    constructed = true;
+    return packet;
   }
 
   return 0;
@@ -501,14 +1206,40 @@ void Packet_reader::set_continue_sent()
   continue_sent_ = true;
 }
 
-Packet* Packet_reader::read_request( const std::string& s )
+bool Packet_reader::take_content( std::string& s )
+{
+  if( !header_read() || !header->content_encoding().empty() )
+    return false;
+
+  if( header->chunked() )
+  {
+    if( !decoded_sz )
+      return false;
+
+    s.assign( content_cache, 0, decoded_sz );
+    content_cache.erase( 0, decoded_sz );
+    taken_sz += decoded_sz;
+    decoded_sz = 0;
+    return true;
+  }
+
+  if( content_cache.empty() )
+    return false;
+
+  s.erase();
+  s.swap( content_cache );
+  taken_sz += s.length();
+  return true;
+}
+
+Packet* Packet_reader::read_request( const char* s, size_t len )
 {
-  return read_packet<Request_header>(s);
+  return read_packet<Request_header>(s, len);
 }
 
-Packet* Packet_reader::read_response( const std::string& s, bool hdr_only )
+Packet* Packet_reader::read_response( const char* s, size_t len, bool hdr_only )
 {
-  return read_packet<Response_header>(s, hdr_only);
+  return read_packet<Response_header>(s, len, hdr_only);
 }
 
 } // namespace http
@@ -4,15 +4,16 @@
 #ifndef _libiqxmlrpc_http_h_
 #define _libiqxmlrpc_http_h_
 
+#include "buffer_chain.h"
+#include "content_encoding.h"
 #include "except.h"
 #include "inet_addr.h"
 #include "xheaders.h"
 
-#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
-#include <map>
 #include <string>
+#include <vector>
 
 namespace iqxmlrpc {
 
@@ -35,6 +36,12 @@ enum Verification_level { HTTP_CHECK_WEAK, HTTP_CHECK_STRICT };
 
 //! HTTP header. Responsible for parsing,
 //! creating generic HTTP headers.
+/*! Header keeps its text in a single string taken over from receive
+    buffer. Parser makes one pass over it and remembers option names and
+    values as ranges of the text, well-known options are stored in fixed
+    slots. Value set later overwrites the old one in place when it fits,
+    otherwise it is appended to the text. Strings are built by accessors
+    only when asked for. */
 class LIBIQXMLRPC_API Header {
 public:
   Header(Verification_level = HTTP_CHECK_WEAK);
@@ -44,8 +51,24 @@ public:
   bool      conn_keep_alive() const;
   bool      expect_continue() const;
 
+  //! Value of Content-Encoding option, empty if there is none.
+  std::string content_encoding() const;
+
+  //! Whether content is sent with chunked transfer coding.
+  bool chunked() const;
+
   void set_content_length( size_t ln );
   void set_conn_keep_alive( bool );
+
+  //! Set "Expect: 100-continue" option.
+  void set_expect_continue();
+
+  //! Set Content-Encoding option, empty value removes it.
+  void set_content_encoding( const std::string& );
+
+  //! Set or remove "Transfer-Encoding: chunked" option.
+  //! Chunked header has no Content-Length.
+  void set_chunked( bool );
   void set_option(const std::string& name, const std::string& value);
 
   void get_xheaders(iqxmlrpc::XHeaders& xheaders) const;
@@ -55,48 +78,103 @@ public:
   std::string dump() const;
 
 protected:
+  //! Options which have dedicated slots. Order matches the table
+  //! of option names and validators in http.cc.
+  enum Known_option {
+    CONTENT_LENGTH,
+    CONTENT_TYPE,
+    CONNECTION,
+    EXPECT,
+    AUTHORIZATION,
+    HOST,
+    USER_AGENT,
+    SERVER,
+    DATE,
+    CONTENT_ENCODING,
+    ACCEPT_ENCODING,
+    TRANSFER_ENCODING,
+    NUM_KNOWN_OPTIONS
+  };
+
   bool option_exists(const std::string&) const;
+  bool option_exists(Known_option k) const { return known_[k].pos != npos; }
   void set_option_default(const std::string& name, const std::string& value);
-  void set_option_default(const std::string& name, unsigned value);
-  void set_option_checked(const std::string& name, const std::string& value);
   void set_option(const std::string& name, size_t value);
 
-  const std::string&  get_head_line() const { return head_line_; }
-  std::string         get_string(const std::string& name) const;
-  unsigned            get_unsigned(const std::string& name) const;
+  //! First line of the header without CRLF.
+  const char* head_line() const { return text_.data() + head_line_.pos; }
+  size_t head_line_length() const { return head_line_.len; }
 
-  //
-  // Parser interface
-  //
+  //! Whether connection is persistent when header has no Connection
+  //! option. It is so for HTTP/1.1 messages.
+  void set_keep_alive_default(bool k) { keep_alive_default_ = k; }
 
-  typedef boost::function<void (const std::string&)> Option_validator_fn;
+  std::string get_string(const std::string& name) const;
+  std::string get_string(Known_option) const;
+  unsigned    get_unsigned(const std::string& name) const;
 
-  void register_validator(
-    const std::string&,
-    Option_validator_fn,
-    Verification_level);
+  //! Parse text taken over from the string, which is left empty.
+  void parse(std::string&);
 
-  void parse(const std::string&);
+  static const size_t npos = static_cast<size_t>(-1);
 
-private:
-  template <class T>
-  T get_option(const std::string& name) const;
+  //! Range of header text.
+  struct Slice {
+    size_t pos;
+    size_t len;
 
-  virtual std::string dump_head() const = 0;
+    Slice(size_t p = npos, size_t l = 0):
+      pos(p), len(l) {}
+  };
+
+  //! Range of header text which starts at p.
+  Slice slice(const char* p, size_t len) const
+  {
+    return Slice(p - text_.data(), len);
+  }
+
+  std::string text(const Slice& s) const { return text_.substr(s.pos, s.len); }
+  Slice append_text(const std::string&);
 
 private:
-  struct Option_validator {
-    Verification_level level;
-    Option_validator_fn fn;
+  virtual std::string dump_head() const = 0;
+
+  struct Option {
+    Slice name;
+    Slice value;
   };
 
-  typedef std::map<std::string, std::string> Options;
-  typedef std::multimap<std::string, Option_validator> Validators;
+  typedef std::vector<Option> Options;
+
+  //! Number of options kept without allocation besides well-known ones.
+  enum { INLINE_OPTIONS = 8 };
+
+  Option& option(size_t i)
+  {
+    return i < INLINE_OPTIONS ? inline_options_[i] : options_[i - INLINE_OPTIONS];
+  }
+
+  const Option& option(size_t i) const
+  {
+    return i < INLINE_OPTIONS ? inline_options_[i] : options_[i - INLINE_OPTIONS];
+  }
 
-  std::string head_line_;
+  size_t find_option(const char* name, size_t len) const;
+  const Slice* find_value(const std::string& name) const;
+  //! Name is either part of the text or is appended to it.
+  void set_value(const char* name, size_t len, const Slice& value);
+  //! Put new value into the slot of existing one.
+  void replace_value(Slice&, const std::string&);
+  bool value_is(Known_option, const char*) const;
+
+  std::string text_;
+  Slice head_line_;
+  Slice known_[NUM_KNOWN_OPTIONS];
+  Option inline_options_[INLINE_OPTIONS];
   Options options_;
-  Validators validators_;
+  size_t num_options_;
   Verification_level ver_level_;
+  bool keep_alive_default_;
 };
 
 #ifdef _MSC_VER
@@ -105,38 +183,54 @@ private:
 
 //! HTTP request's header.
 class LIBIQXMLRPC_API Request_header: public Header {
-  std::string uri_;
+  Slice uri_;
+  Slice version_;
 
 public:
   Request_header( Verification_level, const std::string& to_parse );
+  //! Parse header text taken over from *to_parse, which is left empty.
+  Request_header( Verification_level, std::string* to_parse );
   Request_header( const std::string& uri, const std::string& vhost, int port );
 
-  const std::string& uri() const { return uri_; }
+  std::string uri() const { return text(uri_); }
+
+  //! Protocol version of parsed request, e.g. "HTTP/1.1".
+  std::string version() const { return text(version_); }
   std::string host()  const;
   std::string agent() const;
 
+  //! Value of Accept-Encoding option, empty if there is none.
+  std::string accept_encoding() const;
+  void set_accept_encoding( const std::string& );
+
   bool has_authinfo() const;
   void get_authinfo(std::string& user, std::string& password) const;
+  //! Value of Authorization option as is.
+  std::string raw_authinfo() const;
   void set_authinfo(const std::string& user, const std::string& password);
 
 private:
+  void parse_head();
   virtual std::string dump_head() const;
 };
 
 //! HTTP response's header.
 class LIBIQXMLRPC_API Response_header: public Header {
   int code_;
-  std::string phrase_;
+  Slice phrase_;
 
 public:
   Response_header( Verification_level, const std::string& to_parse );
+  //! Parse header text taken over from *to_parse, which is left empty.
+  Response_header( Verification_level, std::string* to_parse );
   Response_header( int = 200, const std::string& = "OK" );
 
   int code() const { return code_; }
-  const std::string& phrase() const { return phrase_; }
+  std::string phrase() const { return text(phrase_); }
   std::string server() const;
 
 private:
+  void parse_head();
   std::string current_date() const;
   virtual std::string dump_head() const;
 };
@@ -151,22 +245,60 @@ class LIBIQXMLRPC_API Packet {
 protected:
   boost::shared_ptr<http::Header> header_;
   std::string content_;
+  //! Content of chunked packet.
+  std::vector<std::string> chunks_;
 
 public:
   Packet( http::Header* header, const std::string& content );
+
+  //! Create packet with header taken as is. Content is expected
+  //! to be set by swap_content().
+  explicit Packet( http::Header* header );
+
   virtual ~Packet();
 
   //! Sets header option "connection: {keep-alive|close}".
   //! By default connection is close.
   void set_keep_alive( bool = true );
 
+  //! Sets header option "expect: 100-continue".
+  void set_expect_continue();
+
   const http::Header* header()  const { return header_.get(); }
   const std::string&  content() const { return content_; }
 
-  std::string dump() const
-  {
-    return header_->dump() + content_;
-  }
+  //! Exchange content with specified string without copying.
+  //! Updates content length of the header.
+  void swap_content( std::string& );
+
+  //! Set content split into parts, each of them is sent as a chunk
+  //! of chunked transfer coding. Grabs parts leaving vector empty.
+  /*! Single part is set as regular content. */
+  void swap_chunks( std::vector<std::string>& );
+
+  //! Whether content is kept as chunks (see swap_chunks()).
+  bool chunked() const { return !chunks_.empty(); }
+
+  //! Turn chunked packet into a regular one with Content-Length.
+  void join_chunks();
+
+  //! Compress content and set Content-Encoding accordingly.
+  void encode_content( Content_coding );
+
+  //! Decompress content according to its Content-Encoding.
+  /*! \param max_sz Limit of decompressed size, zero means no limit. */
+  void decode_content( size_t max_sz = 0 );
+
+  std::string dump() const;
+
+  //! Move header and content to output buffer, leaving packet empty.
+  /*! Header, content or every chunk are kept as separate segments. */
+  void dump_to( iqnet::Buffer_chain& );
+
+  //! Move chunk of content produced after header has been dumped
+  //! to output buffer (see Header::set_chunked()). Empty data
+  //! ends the content. Grabs data leaving it empty.
+  static void dump_chunk_to( iqnet::Buffer_chain&, std::string& data, bool first );
 };
 
 #ifdef _MSC_VER
@@ -179,20 +311,38 @@ public:
 class Packet_reader {
   std::string header_cache;
   std::string content_cache;
+  std::string pending;
   Header* header;
   Verification_level ver_level_;
   bool constructed;
   size_t pkt_max_sz;
   size_t total_sz;
+  size_t header_sz;
+  size_t scan_pos;
   bool continue_sent_;
 
+  //! State of chunked content decoding. Decoded data is kept
+  //! at the beginning of content_cache, followed by undecoded one.
+  enum Chunk_state { CHUNK_SIZE, CHUNK_DATA, CHUNK_END, CHUNK_TRAILER };
+  Chunk_state chunk_state;
+  size_t chunk_left;
+  size_t decoded_sz;
+  //! Size of content already taken by take_content().
+  size_t taken_sz;
+
 public:
   Packet_reader():
     header(0),
     constructed(false),
     pkt_max_sz(0),
     total_sz(0),
-    continue_sent_(false)
+    header_sz(0),
+    scan_pos(0),
+    continue_sent_(false),
+    chunk_state(CHUNK_SIZE),
+    chunk_left(0),
+    decoded_sz(0),
+    taken_sz(0)
   {
   }
 
@@ -213,17 +363,57 @@ public:
   }
 
   bool expect_continue() const;
-  Packet* read_request( const std::string& );
-  Packet* read_response( const std::string&, bool read_header_only );
+
+  //! Whether header of incoming packet is read and content is expected.
+  bool header_read() const { return header && !constructed; }
+
+  //! Whether some data of next packet has been received.
+  bool has_data() const
+  {
+    return constructed ? !pending.empty() : !header_cache.empty() || header != 0;
+  }
+
+  //! Whether data of next packet was received along with previous
+  //! one (pipelined request). It is parsed by read_request( 0, 0 ).
+  bool has_pending() const { return constructed && !pending.empty(); }
+
+  //! Feed received data. Content of complete packet is moved
+  //! to the returned packet without copying.
+  Packet* read_request( const char*, size_t );
+  Packet* read_response( const char*, size_t, bool read_header_only );
+
+  Packet* read_request( const std::string& s )
+  {
+    return read_request( s.data(), s.length() );
+  }
+
+  Packet* read_response( const std::string& s, bool read_header_only )
+  {
+    return read_response( s.data(), s.length(), read_header_only );
+  }
+
   void set_continue_sent(); 
 
+  //! Move content received so far out of incomplete packet, so that
+  //! it can be processed before the rest arrives. Content of packet
+  //! returned by read_request() is then only the rest of it.
+  //! \return false if there is no content or it is compressed.
+  bool take_content( std::string& );
+
 private:
   void clear();
   void check_sz( size_t );
-  bool read_header( const std::string& );
+  bool read_header( const char*, size_t );
+  void reserve_content();
+  //! Append received content growing the buffer geometrically.
+  void append_content( const char*, size_t );
+
+  //! Decode chunks accumulated in content_cache.
+  //! \return true when last chunk is read.
+  bool decode_chunks();
 
   template <class Header_type>
-  Packet* read_packet( const std::string&, bool = false );
+  Packet* read_packet( const char*, size_t, bool = false );
 };
 
 
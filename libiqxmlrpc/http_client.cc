@@ -24,43 +24,101 @@ Http_client_connection::Http_client_connection( const iqnet::Socket& s, bool nb
 
 http::Packet* Http_client_connection::do_process_session( const std::string& s )
 {
-  out_str = s;
-  resp_packet = 0;
-  reactor->register_handler( this, Reactor_base::OUTPUT );
+  // Rest of pipelined requests may be still unsent.
+  out_str += s;
+  resp_packet = read_buffered_response();
+
+  if( resp_packet )
+    return resp_packet;
+
+  // Responses are read while requests are being sent, otherwise
+  // both sides could block on long pipeline.
+  if( !out_str.empty() )
+    reactor->register_handler( this, Reactor_base::OUTPUT );
+
+  reactor->register_handler( this, Reactor_base::INPUT );
 
   do {
     int to = opts().timeout() >= 0 ? opts().timeout() * 1000 : -1;
+
+    // Header is sent and body waits for server's confirmation.
+    bool waiting = !deferred_body.empty() && out_str.empty();
+    int wait = static_cast<int>(opts().expect_continue_wait());
+    if( waiting && (to < 0 || to > wait) )
+      to = wait;
+
     if( !reactor->handle_events(to) )
-      throw Client_timeout();
+    {
+      if( !waiting )
+        throw Client_timeout();
+
+      send_deferred_body();
+    }
   }
   while( !resp_packet );
 
+  if( !deferred_body.empty() )
+  {
+    // Server has rejected request without reading the body,
+    // so connection is out of sync.
+    std::string().swap( deferred_body );
+    resp_packet->set_keep_alive( false );
+  }
+
   return resp_packet;
 }
 
 
+http::Packet* Http_client_connection::do_process_continue(
+  const std::string& head, std::string& body )
+{
+  deferred_body.swap( body );
+
+  try {
+    return do_process_session( head );
+  }
+  catch( ... )
+  {
+    std::string().swap( deferred_body );
+    throw;
+  }
+}
+
+
+void Http_client_connection::send_deferred_body()
+{
+  if( out_str.empty() )
+    out_str.swap( deferred_body );
+  else
+    out_str += deferred_body;
+
+  std::string().swap( deferred_body );
+  reactor->register_handler( this, Reactor_base::OUTPUT );
+}
+
+
 void Http_client_connection::handle_output( bool& )
 {
   size_t sz = send( out_str.c_str(), out_str.length() );
   out_str.erase( 0, sz );
 
   if( out_str.empty() )
-  {
     reactor->unregister_handler( this, Reactor_base::OUTPUT );
-    reactor->register_handler( this, Reactor_base::INPUT );
-  }
 }
 
 
 void Http_client_connection::handle_input( bool& )
 {
-  for( size_t sz = read_buf_sz(); (sz == read_buf_sz()) && !resp_packet ; )
-  {
-    if( !(sz = recv( read_buf(), read_buf_sz() )) )
-      throw iqnet::network_error( "Connection closed by peer.", false );
+  // One read per event: socket is non-blocking, so reading again
+  // after a full buffer could fail with EAGAIN.
+  size_t sz = recv( read_buf(), read_buf_sz() );
+  if( !sz )
+    throw iqnet::network_error( "Connection closed by peer.", false );
 
-    resp_packet = read_response( std::string(read_buf(), sz) );
-  }
+  resp_packet = read_response( read_buf(), sz );
+
+  if( !resp_packet && continue_received() && !deferred_body.empty() )
+    send_deferred_body();
 
   if( resp_packet )
     reactor->unregister_handler( this );
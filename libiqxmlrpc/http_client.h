@@ -21,6 +21,8 @@ class LIBIQXMLRPC_API Http_client_connection:
 {
   std::auto_ptr<iqnet::Reactor_base> reactor;
   std::string out_str;
+  //! Request body waiting for "100 Continue".
+  std::string deferred_body;
   http::Packet* resp_packet;
 
 public:
@@ -33,6 +35,10 @@ public:
 
 protected:
   http::Packet* do_process_session( const std::string& );
+  http::Packet* do_process_continue( const std::string&, std::string& );
+
+private:
+  void send_deferred_body();
 };
 
 //! XML-RPC \b HTTP PROXY client connection.
@@ -57,6 +57,13 @@ public:
     Error_response( "Unsupported media type '" + wrong + "'", 415 ) {}
 };
 
+//! HTTP/1.1 415 Unsupported media type (content coding)
+class LIBIQXMLRPC_API Unsupported_content_encoding: public Error_response {
+public:
+  Unsupported_content_encoding(const std::string& wrong):
+    Error_response( "Unsupported content encoding '" + wrong + "'", 415 ) {}
+};
+
 //! HTTP/1.1 417 Unsupported expectation
 class LIBIQXMLRPC_API Expectation_failed: public Error_response {
 public:
@@ -16,18 +16,15 @@ class Http_server_connection:
   public iqnet::Connection,
   public Server_connection
 {
-  iqnet::Reactor_base* reactor;
-
 public:
   Http_server_connection( const iqnet::Socket& );
 
-  void set_reactor( iqnet::Reactor_base* r ) { reactor = r; }
-
   void post_accept();
   void finish();
 
   void handle_input( bool& );
   void handle_output( bool& );
+  void handle_timeout( bool& terminate ) { terminate = true; }
 
 
   bool catch_in_reactor() const { return true; }
@@ -35,7 +32,12 @@ public:
   void log_unknown_exception();
 
 private:
+  void dispatch_buffered();
+  void resume_reading();
+
   virtual void do_schedule_response();
+  virtual bool can_send_available() const { return true; }
+  virtual bool send_available();
 };
 
 typedef Server_conn_factory<Http_server_connection> Http_conn_factory;
@@ -49,7 +51,7 @@ typedef Server_conn_factory<Http_server_connection> Http_conn_factory;
 Http_server::Http_server(const iqnet::Inet_addr& bind_addr, Executor_factory_base* ef):
   Server(bind_addr, new Http_conn_factory, ef)
 {
-  static_cast<Http_conn_factory*>(get_conn_factory())->post_init(this, get_reactor());
+  static_cast<Http_conn_factory*>(get_conn_factory())->post_init(this);
 }
 
 //
@@ -65,14 +67,29 @@ Http_server_connection::Http_server_connection( const iqnet::Socket& s ):
 
 void Http_server_connection::post_accept()
 {
-  sock.set_non_blocking(true);
   reactor->register_handler( this, Reactor_base::INPUT );
+  update_read_phase( this );
 }
 
 
 void Http_server_connection::finish()
 {
-  delete this;
+  if( release( this ) )
+    delete this;
+}
+
+
+void Http_server_connection::dispatch_buffered()
+{
+  // Pipelined requests could be read together with previous ones.
+  while( !pipeline_full() )
+  {
+    http::Packet* packet = read_buffered_request();
+    if( !packet )
+      break;
+
+    dispatch( packet );
+  }
 }
 
 
@@ -83,44 +100,80 @@ void Http_server_connection::handle_input( bool& terminate )
 
     if( !n )
     {
-      terminate = true;
+      if( !requests_in_flight() )
+      {
+        terminate = true;
+        return;
+      }
+
+      // Client half-closed connection, answer requests read so far.
+      keep_alive = false;
+      reactor->unregister_handler( this, Reactor_base::INPUT );
+      update_read_phase( this );
       return;
     }
 
-    http::Packet* packet = read_request( std::string(read_buf(), n) );
-    if( !packet )
-      return;
+    http::Packet* packet = read_request( read_buf(), n );
+    if( packet )
+    {
+      dispatch( packet );
+      dispatch_buffered();
+    }
 
-    reactor->unregister_handler( this, Reactor_base::INPUT );
-    server->schedule_execute( packet, this );
+    if( pipeline_full() )
+      reactor->unregister_handler( this, Reactor_base::INPUT );
+
+    update_read_phase( this );
   }
   catch( const http::Error_response& e )
   {
-    // Close connection after sending HTTP error response
-    keep_alive = false;
-    schedule_response( new http::Packet(e) );
+    reactor->unregister_handler( this, Reactor_base::INPUT );
+    respond_error( e );
   }
 }
 
 
 void Http_server_connection::handle_output( bool& terminate )
 {
-  size_t sz = send( response.c_str(), response.length() );
+  if( response.empty() )
+    flush_responses();
 
-  if( sz == response.length() )
-  {
-    if( keep_alive )
-    {
-      reactor->unregister_handler( this, Reactor_base::OUTPUT );
-      reactor->register_handler( this, Reactor_base::INPUT );
-    }
-    else
-      terminate = true;
+  response.consume( send( response ) );
 
+  if( !response.empty() )
+    return;
+
+  reactor->unregister_handler( this, Reactor_base::OUTPUT );
+
+  // Response may have got ready while previous one was being sent.
+  if( response_ready() )
+  {
+    do_schedule_response();
     return;
   }
 
-  response.erase( 0, sz );
+  if( keep_alive || requests_in_flight() )
+    resume_reading();
+  else
+    terminate = true;
+}
+
+
+void Http_server_connection::resume_reading()
+{
+  try {
+    dispatch_buffered();
+
+    if( !pipeline_full() )
+      reactor->register_handler( this, Reactor_base::INPUT );
+
+    update_read_phase( this );
+  }
+  catch( const http::Error_response& e )
+  {
+    reactor->unregister_handler( this, Reactor_base::INPUT );
+    respond_error( e );
+  }
 }
 
 
@@ -130,6 +183,19 @@ void Http_server_connection::do_schedule_response()
 }
 
 
+bool Http_server_connection::send_available()
+{
+  try {
+    response.consume( send_nonblocking( response ) );
+    return true;
+  }
+  catch( const iqnet::network_error& )
+  {
+    return false;
+  }
+}
+
+
 void Http_server_connection::log_exception( const std::exception& ex )
 {
   std::string s( "iqxmlrpc::Http_server_connection: " );
@@ -101,7 +101,7 @@ void Https_proxy_client_connection::handle_input( bool& )
     if( !(sz = recv( read_buf(), read_buf_sz() )) )
       throw iqnet::network_error( "Connection closed by peer.", false );
 
-    resp_packet.reset( read_response(std::string(read_buf(), sz), true) );
+    resp_packet.reset( read_response(read_buf(), sz, true) );
   }
 
   if( resp_packet )
@@ -133,23 +133,79 @@ inline void Https_client_connection::reg_send_request()
 
 http::Packet* Https_client_connection::do_process_session( const std::string& s )
 {
+  resp_packet = read_buffered_response();
+
+  if( resp_packet )
+    return resp_packet;
+
   out_str = s;
-  resp_packet = 0;
 
+  // Empty string means pipelined request has been sent already.
   if( established )
-    reg_send_request();
+  {
+    if( out_str.empty() )
+      reg_recv( read_buf(), read_buf_sz() );
+    else
+      reg_send_request();
+  }
 
   do {
     int to = opts().timeout() >= 0 ? opts().timeout() * 1000 : -1;
+
+    // Header is sent and body waits for server's confirmation.
+    bool waiting = !deferred_body.empty() && reading();
+    int wait = static_cast<int>(opts().expect_continue_wait());
+    if( waiting && (to < 0 || to > wait) )
+      to = wait;
+
     if( !reactor->handle_events(to) )
-      throw Client_timeout();
+    {
+      if( !waiting )
+        throw Client_timeout();
+
+      reactor->unregister_handler( this );
+      send_deferred_body();
+    }
   }
   while( !resp_packet );
 
+  if( !deferred_body.empty() )
+  {
+    // Server has rejected request without reading the body,
+    // so connection is out of sync.
+    std::string().swap( deferred_body );
+    resp_packet->set_keep_alive( false );
+  }
+
   return resp_packet;
 }
 
 
+http::Packet* Https_client_connection::do_process_continue(
+  const std::string& head, std::string& body )
+{
+  deferred_body.swap( body );
+
+  try {
+    return do_process_session( head );
+  }
+  catch( ... )
+  {
+    std::string().swap( deferred_body );
+    throw;
+  }
+}
+
+
+void Https_client_connection::send_deferred_body()
+{
+  // Header has been sent, so output buffer is free.
+  out_str.swap( deferred_body );
+  std::string().swap( deferred_body );
+  reg_send_request();
+}
+
+
 void Https_client_connection::connect_succeed()
 {
   established = true;
@@ -168,13 +224,15 @@ void Https_client_connection::recv_succeed( bool&, size_t, size_t sz )
   if( !sz )
     throw iqnet::network_error( "Connection closed by peer.", false );
 
-  std::string s( read_buf(), sz );
-  resp_packet = read_response( s );
+  resp_packet = read_response( read_buf(), sz );
 
-  if( !resp_packet )
-  {
+  if( resp_packet )
+    return;
+
+  if( continue_received() && !deferred_body.empty() )
+    send_deferred_body();
+  else
     reg_recv( read_buf(), read_buf_sz() );
-  }
 }
 
 } // namespace iqxmlrpc
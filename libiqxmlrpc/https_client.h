@@ -30,6 +30,9 @@ public:
 protected:
   http::Packet* do_process_session( const std::string& );
 
+  //! Tunnel is set up for each session.
+  bool can_pipeline() const { return false; }
+
   void setup_tunnel();
 
   boost::scoped_ptr<iqnet::Reactor_base> reactor;
@@ -46,6 +49,8 @@ class LIBIQXMLRPC_API Https_client_connection:
   std::auto_ptr<iqnet::Reactor_base> reactor;
   http::Packet* resp_packet;
   std::string out_str;
+  //! Request body waiting for "100 Continue".
+  std::string deferred_body;
   bool established;
 
 public:
@@ -66,9 +71,11 @@ public:
 protected:
   friend class Https_proxy_client_connection;
   http::Packet* do_process_session( const std::string& );
+  http::Packet* do_process_continue( const std::string&, std::string& );
 
 private:
   void reg_send_request();
+  void send_deferred_body();
 };
 
 } // namespace iqxmlrpc
@@ -19,8 +19,24 @@ class Https_server_connection:
 public:
   Https_server_connection( const iqnet::Socket& );
 
-  void post_accept() { Reaction_connection::post_accept(); }
-  void finish() { delete this; }
+  void set_reactor( iqnet::Reactor_base* r )
+  {
+    Reaction_connection::set_reactor( r );
+    Server_connection::set_reactor( r );
+  }
+
+  void post_accept()
+  {
+    Reaction_connection::post_accept();
+    update_read_phase( this );
+  }
+
+  void finish()
+  {
+    if( release( this ) )
+      delete this;
+  }
+  void handle_timeout( bool& terminate ) { terminate = true; }
 
   bool catch_in_reactor() const { return true; }
   void log_exception( const std::exception& );
@@ -45,7 +61,7 @@ typedef Server_conn_factory<Https_server_connection> Https_conn_factory;
 Https_server::Https_server(const iqnet::Inet_addr& bind_addr, Executor_factory_base* ef):
   Server(bind_addr, new Https_conn_factory, ef)
 {
-  static_cast<Https_conn_factory*>(get_conn_factory())->post_init(this, get_reactor());
+  static_cast<Https_conn_factory*>(get_conn_factory())->post_init(this);
 }
 
 
@@ -76,35 +92,56 @@ void Https_server_connection::recv_succeed( bool&, size_t, size_t real_len )
 {
   try
   {
-    std::string s( read_buf(), real_len );
-    http::Packet* packet = read_request( s );
+    http::Packet* packet = read_request( read_buf(), real_len );
 
-    if( !packet )
-    {
-      if (response.empty())
-        my_reg_recv();
-      return;
-    }
+    if( packet )
+      dispatch( packet );
+    else if( response.empty() )
+      my_reg_recv();
 
-    server->schedule_execute( packet, this );
+    update_read_phase( this );
   }
   catch( const http::Error_response& e )
   {
-    // Close connection after sending HTTP error response
-    keep_alive = false;
-    schedule_response( new http::Packet(e) );
+    respond_error( e );
   }
 }
 
 
 void Https_server_connection::send_succeed( bool& terminate )
 {
-  response = std::string();
+  // Each segment is sent by separate SSL_write.
+  response.consume( response.length() );
+
+  if( !response.empty() || flush_responses() )
+  {
+    do_schedule_response();
+    return;
+  }
 
-  if( keep_alive )
-    my_reg_recv();
-  else
+  if( !keep_alive )
+  {
     terminate = reg_shutdown();
+    return;
+  }
+
+  // SSL connection serves one request at a time, next pipelined
+  // request may be already read along with the previous one.
+  try
+  {
+    http::Packet* packet = read_buffered_request();
+
+    if( packet )
+      dispatch( packet );
+    else
+      my_reg_recv();
+
+    update_read_phase( this );
+  }
+  catch( const http::Error_response& e )
+  {
+    respond_error( e );
+  }
 }
 
 #ifdef _MSC_VER
@@ -114,6 +151,10 @@ void Https_server_connection::send_succeed( bool& terminate )
 
 void Https_server_connection::do_schedule_response()
 {
+  // Output buffer is empty only when called by executor.
+  if( response.empty() && !flush_ready() )
+    return;
+
   reg_send( response.data(), response.length() );
 }
 
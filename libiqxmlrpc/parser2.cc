@@ -3,10 +3,13 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <string.h>
 #include <libxml/xmlreader.h>
 #include <libxml/xmlIO.h>
+#include <boost/scoped_ptr.hpp>
 #include "parser2.h"
 #include "except.h"
+#include "xml_tokenizer.h"
 #include <iostream>
 
 namespace iqxmlrpc {
@@ -25,8 +28,66 @@ to_string(xmlChar* s)
   return std::string();
 }
 
+struct TagEntry {
+  const char* name;
+  size_t len;
+  XmlRpcTag tag;
+};
+
+//! Tag names placed by perfect hash, see lookup_tag().
+const TagEntry tag_table[32] = {
+  { "int",              3,  TAG_INT },
+  { "member",           6,  TAG_MEMBER },
+  { "methodResponse",   14, TAG_METHOD_RESPONSE },
+  { "boolean",          7,  TAG_BOOLEAN },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "nil",              3,  TAG_NIL },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "dateTime.iso8601", 16, TAG_DATETIME },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "array",            5,  TAG_ARRAY },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "data",             4,  TAG_DATA },
+  { 0,                  0,  TAG_UNKNOWN },
+  { 0,                  0,  TAG_UNKNOWN },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "params",           6,  TAG_PARAMS },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "name",             4,  TAG_NAME },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "methodCall",       10, TAG_METHOD_CALL },
+  { "base64",           6,  TAG_BASE64 },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "string",           6,  TAG_STRING },
+  { "fault",            5,  TAG_FAULT },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "double",           6,  TAG_DOUBLE },
+  { "value",            5,  TAG_VALUE },
+  { 0,                  0,  TAG_UNKNOWN },
+  { "param",            5,  TAG_PARAM },
+  { "struct",           6,  TAG_STRUCT },
+  { "methodName",       10, TAG_METHOD_NAME },
+  { "i4",               2,  TAG_I4 }
+};
+
 } // nameless namespace
 
+XmlRpcTag
+lookup_tag(const char* name, size_t len)
+{
+  if (!len)
+    return TAG_UNKNOWN;
+
+  // Length, first and last characters give distinct slots for all tags.
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(name);
+  const TagEntry& e = tag_table[(len + 25 * s[0] + 3 * s[len - 1]) & 31];
+
+  if (e.len == len && !memcmp(e.name, name, len))
+    return e.tag;
+
+  return TAG_UNKNOWN;
+}
+
 struct LibxmlInitializer {
   LibxmlInitializer()
   {
@@ -45,7 +106,8 @@ BuilderBase::BuilderBase(Parser& p, bool t):
   parser_(p),
   depth_(0),
   expect_text_(t),
-  want_exit_(false)
+  want_exit_(false),
+  want_data_(false)
 {
 }
 
@@ -57,14 +119,27 @@ BuilderBase::build(bool flat)
 }
 
 void
-BuilderBase::visit_element(const std::string& tag)
+BuilderBase::feed(const char* s, size_t len, bool last)
+{
+  parser_.feed(*this, s, len, last);
+}
+
+void
+BuilderBase::start_sub_build(BuilderBase* b, bool flat)
+{
+  b->depth_ += flat ? 1 : 0;
+  parser_.push_builder(b);
+}
+
+void
+BuilderBase::visit_element(XmlRpcTag tag)
 {
   depth_++;
   do_visit_element(tag);
 }
 
 void
-BuilderBase::visit_element_end(const std::string& tag)
+BuilderBase::visit_element_end(XmlRpcTag tag)
 {
   depth_--;
   do_visit_element_end(tag);
@@ -80,7 +155,20 @@ BuilderBase::visit_text(const std::string& text)
 }
 
 void
-BuilderBase::do_visit_element_end(const std::string&)
+BuilderBase::visit_data(const std::string& data)
+{
+  want_data_ = false;
+  do_visit_data(data);
+}
+
+void
+BuilderBase::visit_sub_build(BuilderBase& b)
+{
+  do_visit_sub_build(b);
+}
+
+void
+BuilderBase::do_visit_element_end(XmlRpcTag)
 {
 }
 
@@ -93,32 +181,26 @@ BuilderBase::do_visit_text(const std::string&)
   }
 }
 
-//
-// Parser
-//
+void
+BuilderBase::do_visit_data(const std::string&)
+{
+}
 
-class Parser::Impl {
-public:
-  Impl(const std::string& str):
-    buf(str),
-    pushed_back(false)
-  {
-    const char* buf2 = str.data();
-    int sz = static_cast<int>(str.size());
-#if (LIBXML_VERSION < 20703)
-#define XML_PARSE_HUGE 0
-#endif
-    reader = xmlReaderForMemory(buf2, sz, 0, 0, XML_PARSE_NONET | XML_PARSE_HUGE);
-    xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, 0); // No XXE
-  }
+void
+BuilderBase::do_visit_sub_build(BuilderBase&)
+{
+}
 
-  ~Impl()
-  {
-    xmlFreeTextReader(reader);
-  }
+namespace {
+
+//! Source of document nodes for Parser.
+class Reader {
+public:
+  virtual ~Reader() {}
 
   struct ParseStep {
     bool done;
+    bool need_more;
     bool element_begin;
     bool element_end;
     bool is_empty;
@@ -126,16 +208,21 @@ public:
 
     ParseStep():
       done(false),
-      is_empty(false)
+      need_more(false),
+      element_begin(false),
+      element_end(false),
+      is_empty(false),
+      is_text(false)
     {
     }
 
-    ParseStep(int type, xmlTextReaderPtr reader):
+    ParseStep(bool begin, bool end, bool empty, bool text):
       done(false),
-      element_begin(type == XML_READER_TYPE_ELEMENT),
-      element_end(type == XML_READER_TYPE_END_ELEMENT),
-      is_empty(element_begin && xmlTextReaderIsEmptyElement(reader)),
-      is_text(type == XML_READER_TYPE_TEXT)
+      need_more(false),
+      element_begin(begin),
+      element_end(end),
+      is_empty(empty),
+      is_text(text)
     {
     }
   };
@@ -143,11 +230,6 @@ public:
   ParseStep
   read()
   {
-    if (pushed_back) {
-      pushed_back = false;
-      return curr;
-    }
-
     if (curr.is_empty) {
       curr.element_begin = false;
       curr.element_end = true;
@@ -155,114 +237,431 @@ public:
       return curr;
     }
 
+    if (!read_node(curr))
+      curr.done = true;
+
+    return curr;
+  }
+
+  //! Name of current element without namespace prefix.
+  Xml_tokenizer::Slice
+  local_name()
+  {
+    Xml_tokenizer::Slice s = node_name();
+
+    const char* colon = static_cast<const char*>(memchr(s.data, ':', s.len));
+    if (colon) {
+      s.len -= colon + 1 - s.data;
+      s.data = colon + 1;
+    }
+
+    return s;
+  }
+
+  XmlRpcTag
+  tag()
+  {
+    Xml_tokenizer::Slice s = local_name();
+    return lookup_tag(s.data, s.len);
+  }
+
+  virtual std::string
+  get_context() const = 0;
+
+  virtual std::string
+  node_text() = 0;
+
+  //! Append next part of document received in parts.
+  virtual void
+  feed(const char*, size_t, bool) {}
+
+  //! Read rest of document (received so far),
+  //! throw Parse_error if it is malformed.
+  virtual void
+  check_rest() {}
+
+protected:
+  //! Read next node. \return false at the end of document.
+  virtual bool
+  read_node(ParseStep&) = 0;
+
+  //! Qualified name of current element.
+  virtual Xml_tokenizer::Slice
+  node_name() = 0;
+
+  ParseStep curr;
+};
+
+//! Reader based on libxml2 xmlTextReader.
+class Libxml_reader: public Reader {
+public:
+  Libxml_reader(const std::string& str)
+  {
+    const char* buf2 = str.data();
+    int sz = static_cast<int>(str.size());
+#if (LIBXML_VERSION < 20703)
+#define XML_PARSE_HUGE 0
+#endif
+    reader = xmlReaderForMemory(buf2, sz, 0, 0, XML_PARSE_NONET | XML_PARSE_HUGE);
+    xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, 0); // No XXE
+  }
+
+  ~Libxml_reader()
+  {
+    xmlFreeTextReader(reader);
+  }
+
+  std::string
+  get_context() const
+  {
+    xmlNodePtr n = xmlTextReaderCurrentNode(reader);
+    return to_string(xmlGetNodePath(n));
+  }
+
+  std::string
+  node_text()
+  {
+    return to_string(xmlTextReaderValue(reader));
+  }
+
+private:
+  bool
+  read_node(ParseStep& step)
+  {
     int code = xmlTextReaderRead(reader);
-    curr.done = true;
 
     if (code < 0) {
       xmlErrorPtr err = xmlGetLastError();
       throw Parse_error(err ? err->message : "unknown parsing error");
     }
 
-    if (code > 0) {
-      curr = ParseStep(node_type(), reader);
-    }
+    if (!code)
+      return false;
 
-    return curr;
+    int type = xmlTextReaderNodeType(reader);
+    bool begin = type == XML_READER_TYPE_ELEMENT;
+
+    step = ParseStep(
+      begin,
+      type == XML_READER_TYPE_END_ELEMENT,
+      begin && xmlTextReaderIsEmptyElement(reader),
+      type == XML_READER_TYPE_TEXT);
+
+    return true;
+  }
+
+  Xml_tokenizer::Slice
+  node_name()
+  {
+    const char* s = reinterpret_cast<const char*>(xmlTextReaderConstName(reader));
+    return s ? Xml_tokenizer::Slice(s, strlen(s)) : Xml_tokenizer::Slice();
+  }
+
+  xmlTextReaderPtr reader;
+};
+
+//! Reader based on built-in tokenizer.
+class Native_reader: public Reader {
+public:
+  Native_reader(const std::string& str):
+    tokenizer(str)
+  {
   }
 
-  int
-  node_type()
+  Native_reader()
   {
-    return xmlTextReaderNodeType(reader);
   }
 
-  int
-  depth()
+  std::string
+  get_context() const
   {
-    return xmlTextReaderDepth(reader);
+    return tokenizer.path();
   }
 
   std::string
-  tag_name()
+  node_text()
   {
-    std::string rv = to_string(xmlTextReaderName(reader));
+    std::string rv;
+    tokenizer.decode_text(rv);
+    return rv;
+  }
 
-    size_t pos = rv.find_first_of(":");
-    if (pos != std::string::npos)
-    {
-      rv.erase(0, pos+1);
+  void
+  feed(const char* s, size_t len, bool last)
+  {
+    tokenizer.feed(s, len, last);
+  }
+
+  void
+  check_rest()
+  {
+    for (;;) {
+      Xml_tokenizer::Token t = tokenizer.next();
+
+      if (t == Xml_tokenizer::END_OF_DOC || t == Xml_tokenizer::NEED_MORE)
+        break;
     }
+  }
 
-    return rv;
+private:
+  bool
+  read_node(ParseStep& step)
+  {
+    Xml_tokenizer::Token t = tokenizer.next();
+
+    if (t == Xml_tokenizer::END_OF_DOC)
+      return false;
+
+    bool empty = t == Xml_tokenizer::EMPTY_ELEMENT;
+
+    step = ParseStep(
+      t == Xml_tokenizer::ELEMENT || empty,
+      t == Xml_tokenizer::ELEMENT_END,
+      empty,
+      t == Xml_tokenizer::TEXT);
+
+    step.need_more = t == Xml_tokenizer::NEED_MORE;
+    return true;
   }
 
-  std::string
-  read_data()
+  Xml_tokenizer::Slice
+  node_name()
   {
-    if (!curr.is_text && !curr.element_end)
-    {
-      read();
-      if (!curr.is_text && !curr.element_end) {
-        std::string err = "text is expected at " + get_context();
-        throw XML_RPC_violation(err);
+    return tokenizer.name();
+  }
+
+  Xml_tokenizer tokenizer;
+};
+
+} // anonymous namespace
+
+//
+// Parser
+//
+
+//! Passes nodes to the builder which turn it is. Builders are
+//! kept in stack, so that document can be parsed in parts.
+class Parser::Impl {
+public:
+  Impl(Reader* r = 0):
+    reader(r),
+    fallback(false),
+    failed(false)
+  {
+  }
+
+  ~Impl()
+  {
+    drop_builders();
+  }
+
+  //! Pass nodes to builders until they are done or data is over.
+  void
+  run()
+  {
+    while (!builders.empty()) {
+      Reader::ParseStep p = reader->read();
+
+      if (p.need_more)
+        return;
+
+      if (p.done) {
+        if (builders.back()->wants_data())
+          throw XML_RPC_violation("text is expected at " + reader->get_context());
+
+        while (!builders.empty())
+          pop_builder();
+
+        return;
       }
+
+      dispatch(p);
     }
-    return to_string(xmlTextReaderValue(reader));
   }
 
-  std::string
-  get_context() const
+  void
+  drop_builders()
   {
-    xmlNodePtr n = xmlTextReaderCurrentNode(reader);
-    return to_string(xmlGetNodePath(n));
+    for (size_t i = 1; i < builders.size(); ++i)
+      delete builders[i];
+
+    builders.clear();
   }
 
-  const std::string buf;
-  xmlTextReaderPtr reader;
-  ParseStep curr;
-  bool pushed_back;
+  boost::scoped_ptr<Reader> reader;
+  //! The first builder is not owned.
+  std::vector<BuilderBase*> builders;
+  //! Beginning of document received in parts, kept until it is known
+  //! which reader can parse it. Whole document for libxml2.
+  std::string head;
+  bool fallback;
+  bool failed;
+
+private:
+  void
+  dispatch(const Reader::ParseStep& p)
+  {
+    BuilderBase* b = builders.back();
+
+    if (b->wants_data()) {
+      if (!p.is_text && !p.element_end)
+        throw XML_RPC_violation("text is expected at " + reader->get_context());
+
+      b->visit_data(p.is_text ? reader->node_text() : std::string());
+
+    } else if (p.element_begin) {
+      b->visit_element(reader->tag());
+
+    } else if (p.element_end) {
+      if (!b->depth()) {
+        // Element belongs to one of enclosing builders.
+        pop_builder();
+        if (!builders.empty())
+          dispatch(p);
+
+        return;
+      }
+
+      b->visit_element_end(reader->tag());
+
+    } else if (p.is_text && b->expects_text()) {
+      b->visit_text(reader->node_text());
+    }
+
+    // Otherwise builder waits for nested one.
+    if (builders.back() == b && b->wants_exit())
+      pop_builder();
+  }
+
+  //! Remove builder which is done and pass it to enclosing one.
+  void
+  pop_builder()
+  {
+    for (;;) {
+      std::auto_ptr<BuilderBase> done(builders.back());
+      builders.pop_back();
+
+      if (builders.empty()) {
+        done.release();
+        return;
+      }
+
+      BuilderBase* b = builders.back();
+      b->visit_sub_build(*done);
+
+      if (!b->wants_exit())
+        return;
+    }
+  }
 };
 
-Parser::Parser(const std::string& buf):
-  impl_(new Parser::Impl(buf))
+Parser::Parser(const std::string& buf, bool allow_native)
+{
+  if (allow_native && Xml_tokenizer::supports(buf))
+    impl_.reset(new Impl(new Native_reader(buf)));
+  else
+    impl_.reset(new Impl(new Libxml_reader(buf)));
+}
+
+Parser::Parser():
+  impl_(new Impl)
 {
 }
 
 void
 Parser::parse(BuilderBase& builder)
 {
-  for (Impl::ParseStep p = impl_->read(); !p.done; p = impl_->read()) {
-    if (p.element_begin) {
-      builder.visit_element(impl_->tag_name());
+  impl_->builders.push_back(&builder);
 
-    } else if (p.element_end) {
-      if (!builder.depth()) {
-        impl_->pushed_back = true;
-        break;
-      }
+  try {
+    impl_->run();
+  }
+  catch (const Parse_error&) {
+    impl_->drop_builders();
+    throw;
+  }
+  catch (...) {
+    // Malformed document is reported as such
+    // even if the error is beyond rejected content.
+    impl_->drop_builders();
+    impl_->reader->check_rest();
+    throw;
+  }
+
+  // The same goes for the rest of document builders are not interested in.
+  impl_->reader->check_rest();
+}
+
+void
+Parser::feed(BuilderBase& builder, const char* s, size_t len, bool last)
+{
+  Impl& i = *impl_;
+
+  if (!i.reader) {
+    i.head.append(s, len);
+
+    Xml_tokenizer::Support sup = i.fallback ? Xml_tokenizer::UNSUPPORTED :
+      Xml_tokenizer::check_prolog(i.head.data(), i.head.length(), last);
 
-      builder.visit_element_end(impl_->tag_name());
+    if (sup == Xml_tokenizer::UNKNOWN)
+      return;
 
-    } else if (p.is_text && builder.expects_text()) {
-      builder.visit_text(get_data());
+    if (sup == Xml_tokenizer::UNSUPPORTED) {
+      i.fallback = true;
+      if (!last)
+        return;
+
+      i.reader.reset(new Libxml_reader(i.head));
+    } else {
+      i.reader.reset(new Native_reader);
+      i.reader->feed(i.head.data(), i.head.length(), last);
+      std::string().swap(i.head);
     }
 
-    if (builder.wants_exit())
-      break;
+    i.builders.push_back(&builder);
+  } else {
+    i.reader->feed(s, len, last);
+  }
+
+  try {
+    if (!i.failed)
+      i.run();
 
-  } // for
+    if (i.builders.empty())
+      i.reader->check_rest();
+  }
+  catch (const Parse_error&) {
+    i.drop_builders();
+    i.failed = true;
+    throw;
+  }
+  catch (...) {
+    i.drop_builders();
+    i.failed = true;
+    i.reader->check_rest();
+    throw;
+  }
 }
 
-std::string
-Parser::get_data()
+void
+Parser::push_builder(BuilderBase* b)
 {
-  return impl_->read_data();
+  std::auto_ptr<BuilderBase> p(b);
+  impl_->builders.push_back(b);
+  p.release();
 }
 
 std::string
 Parser::context() const
 {
-  return impl_->get_context();
+  return impl_->reader->get_context();
+}
+
+std::string
+Parser::tag_name() const
+{
+  Xml_tokenizer::Slice s = impl_->reader->local_name();
+  return std::string(s.data, s.len);
 }
 
 //
@@ -282,11 +681,11 @@ StateMachine::set_transitions(const StateTransition* t)
 }
 
 int
-StateMachine::change(const std::string& tag)
+StateMachine::change(XmlRpcTag tag)
 {
   bool found = false;
   size_t i = 0;
-  for (; trans_[i].tag != 0; ++i) {
+  for (; trans_[i].tag != TAG_UNKNOWN; ++i) {
     if (trans_[i].tag == tag && trans_[i].prev_state == curr_) {
       found = true;
       break;
@@ -294,7 +693,7 @@ StateMachine::change(const std::string& tag)
   }
 
   if (!found) {
-    std::string err = "unexpected tag <" + std::string(tag) + "> at " + parser_.context();
+    std::string err = "unexpected tag <" + parser_.tag_name() + "> at " + parser_.context();
     throw XML_RPC_violation(err);
   }
 
@@ -13,25 +13,75 @@ namespace iqxmlrpc {
 
 class Parser;
 
+//! Identifiers of known XML-RPC tags, builders dispatch on them
+//! instead of comparing tag names.
+enum XmlRpcTag {
+  TAG_UNKNOWN = 0,
+  TAG_ARRAY,
+  TAG_BASE64,
+  TAG_BOOLEAN,
+  TAG_DATA,
+  TAG_DATETIME,
+  TAG_DOUBLE,
+  TAG_FAULT,
+  TAG_I4,
+  TAG_INT,
+  TAG_MEMBER,
+  TAG_METHOD_CALL,
+  TAG_METHOD_NAME,
+  TAG_METHOD_RESPONSE,
+  TAG_NAME,
+  TAG_NIL,
+  TAG_PARAM,
+  TAG_PARAMS,
+  TAG_STRING,
+  TAG_STRUCT,
+  TAG_VALUE
+};
+
+//! Get identifier of local tag name, TAG_UNKNOWN for unknown ones.
+XmlRpcTag
+lookup_tag(const char* name, size_t len);
+
+//! Base class of builders which get document nodes from Parser.
+/*! Builder may pass part of document to nested builder
+    (see sub_build()) or ask for text of element (see want_data()),
+    then it gets the result when parser reaches it. */
 class BuilderBase {
 public:
   BuilderBase(Parser&, bool expect_text = false);
 
+  virtual ~BuilderBase() {}
+
   void
-  visit_element(const std::string& tag);
+  visit_element(XmlRpcTag tag);
 
   void
-  visit_element_end(const std::string& tag);
+  visit_element_end(XmlRpcTag tag);
 
   void
   visit_text(const std::string&);
 
+  //! Pass text requested by want_data().
+  void
+  visit_data(const std::string&);
+
+  //! Pass nested builder started by sub_build() when it is done.
+  void
+  visit_sub_build(BuilderBase&);
+
   bool
   expects_text() const
   {
     return expect_text_;
   }
 
+  bool
+  wants_data() const
+  {
+    return want_data_;
+  }
+
   int
   depth() const
   {
@@ -44,17 +94,22 @@ public:
     return want_exit_;
   }
 
+  //! Build from whole document.
   void
   build(bool flat = false);
 
+  //! Build from next part of document received in parts.
+  //! \see Parser::feed()
+  void
+  feed(const char*, size_t, bool last = false);
+
 protected:
-  template <class R, class BUILDER>
-  R
+  //! Pass following nodes to new builder of specified type until it exits.
+  template <class BUILDER>
+  void
   sub_build(bool flat = false)
   {
-    BUILDER b(parser_);
-    b.build(flat);
-    return b.result();
+    start_sub_build(new BUILDER(parser_), flat);
   }
 
   void
@@ -63,36 +118,74 @@ protected:
     want_exit_ = true;
   }
 
+  //! Ask for text of current element, which is passed to do_visit_data().
+  void
+  want_data()
+  {
+    want_data_ = true;
+  }
+
   virtual void
-  do_visit_element(const std::string&) = 0;
+  do_visit_element(XmlRpcTag) = 0;
 
   virtual void
-  do_visit_element_end(const std::string&);
+  do_visit_element_end(XmlRpcTag);
 
   virtual void
   do_visit_text(const std::string&);
 
+  virtual void
+  do_visit_data(const std::string&);
+
+  virtual void
+  do_visit_sub_build(BuilderBase&);
+
   Parser& parser_;
   int depth_;
   bool expect_text_;
   bool want_exit_;
+  bool want_data_;
+
+private:
+  void
+  start_sub_build(BuilderBase*, bool flat);
 };
 
 class Parser {
 public:
-  Parser(const std::string& buf);
+  class Impl;
+
+  //! \param allow_native Use built-in tokenizer if document is in the
+  //! XML subset it supports (see Xml_tokenizer), otherwise libxml2 is used.
+  Parser(const std::string& buf, bool allow_native = true);
+
+  //! Create parser of document received in parts, see feed().
+  Parser();
 
   void
   parse(BuilderBase& builder);
 
-  std::string
-  get_data();
+  //! Pass next part of document to builder as soon as it is received.
+  /*! Exceptions are thrown by the call which passes data causing
+      them. After builder's exception the rest of document is only
+      checked to be well-formed, so later parts may still cause
+      Parse_error. Parser must not be fed after Parse_error. */
+  void
+  feed(BuilderBase& builder, const char*, size_t, bool last = false);
+
+  //! Pass following nodes to nested builder until it exits.
+  //! Grabs ownership.
+  void
+  push_builder(BuilderBase*);
 
   std::string
   context() const;
 
+  //! Local name of current element.
+  std::string
+  tag_name() const;
+
 private:
-  class Impl;
   boost::shared_ptr<Impl> impl_;
 };
 
@@ -101,7 +194,7 @@ public:
   struct StateTransition {
     int prev_state;
     int new_state;
-    const char* tag;
+    XmlRpcTag tag;
   };
 
   StateMachine(const Parser&, int start_state);
@@ -113,7 +206,7 @@ public:
   get_state() const { return curr_; }
 
   int
-  change(const std::string& tag);
+  change(XmlRpcTag tag);
 
   void
   set_state(int new_state);
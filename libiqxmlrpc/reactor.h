@@ -8,7 +8,7 @@
 #include "net_except.h"
 #include "socket.h"
 
-#include <list>
+#include <vector>
 
 namespace iqnet
 {
@@ -23,6 +23,8 @@ public:
 
   virtual void handle_input( bool& /* terminate */) {}
   virtual void handle_output( bool& /* terminate */) {}
+  //! Invoked by Reactor when timer set by Reactor_base::set_timer() expires.
+  virtual void handle_timeout( bool& /* terminate */) {}
 
   //! Invoked by Reactor when handle_X()
   //! sets terminate variable to true.
@@ -38,6 +40,11 @@ public:
   virtual Socket::Handler get_handler() const = 0;
 };
 
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
 //! Abstract base for Reactor template.
 //! It defines interface, standard exceptions and
 //! general data structures for all implementations.
@@ -68,9 +75,12 @@ public:
     }
   };
 
-  typedef std::list<HandlerState> HandlerStateList;
+  typedef std::vector<HandlerState> HandlerStateList;
   typedef int Timeout;
 
+  //! Size of read_buffer().
+  static const size_t read_buffer_sz = 65536;
+
   virtual ~Reactor_base() {};
 
   virtual void register_handler( Event_handler*, Event_mask )   = 0;
@@ -78,11 +88,27 @@ public:
   virtual void unregister_handler( Event_handler* ) = 0;
   virtual void fake_event( Event_handler*, Event_mask ) = 0;
 
+  //! Call handler's handle_timeout() in specified number of milliseconds.
+  /*! Handler may have only one timer, setting new one replaces previous.
+      Zero timeout cancels the timer. Timer is cancelled as well
+      when handler is unregistered. */
+  virtual void set_timer( Event_handler*, unsigned ms ) = 0;
+
   //! \return true if any handle was invoked, false on timeout.
   /*! Throws Reactor::No_handlers when no one handler has been registered. */
   virtual bool handle_events( Timeout ms = -1 ) = 0;
+
+  //! Scratch buffer of read_buffer_sz bytes for handlers
+  //! which read data in reactor's thread.
+  /*! Content is valid only until handler returns control to reactor,
+      so connections do not need to keep their own buffers while idle. */
+  virtual char* read_buffer() = 0;
 };
 
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
 } // namespace iqnet
 
 #endif
@@ -0,0 +1,133 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "config.h"
+
+#ifdef HAVE_EPOLL
+#include "reactor_epoll_impl.h"
+
+#include <sys/epoll.h>
+#include <vector>
+
+using namespace iqnet;
+
+typedef Reactor_base::HandlerStateList HandlerStateList;
+
+namespace {
+
+inline unsigned epoll_events(short mask)
+{
+  unsigned events = mask & Reactor_base::INPUT ? unsigned(EPOLLIN) : 0;
+  events |= mask & Reactor_base::OUTPUT ? unsigned(EPOLLOUT) : 0;
+  return events;
+}
+
+} // anonymous namespace
+
+struct Reactor_epoll_impl::Impl {
+  typedef std::vector<struct epoll_event> Event_vec;
+
+  int epfd;
+  Event_vec events;
+
+  Impl():
+    epfd(epoll_create1(EPOLL_CLOEXEC)),
+    events(64)
+  {
+    if( epfd == -1 )
+      throw network_error( "epoll_create1()" );
+  }
+
+  ~Impl()
+  {
+    ::close( epfd );
+  }
+
+  int ctl(int op, Socket::Handler fd, short mask)
+  {
+    struct epoll_event ev;
+    ev.events = epoll_events(mask);
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    return epoll_ctl( epfd, op, fd, &ev );
+  }
+};
+
+Reactor_epoll_impl::Reactor_epoll_impl():
+  impl(new Impl)
+{
+}
+
+Reactor_epoll_impl::~Reactor_epoll_impl()
+{
+  delete impl;
+}
+
+void Reactor_epoll_impl::update(Socket::Handler fd, short old_mask, short new_mask)
+{
+  if( !new_mask )
+  {
+    // Descriptor could be already closed by its owner,
+    // kernel drops it from interest set in that case.
+    if( impl->ctl(EPOLL_CTL_DEL, fd, 0) == -1 && errno != ENOENT && errno != EBADF )
+      throw network_error( "epoll_ctl(EPOLL_CTL_DEL)" );
+
+    return;
+  }
+
+  int op = old_mask ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if( impl->ctl(op, fd, new_mask) == 0 )
+    return;
+
+  // Descriptor number was reused after close() or
+  // is still known by kernel: retry with complementary operation.
+  if( (op == EPOLL_CTL_MOD && errno == ENOENT) || (op == EPOLL_CTL_ADD && errno == EEXIST) )
+  {
+    op = op == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if( impl->ctl(op, fd, new_mask) == 0 )
+      return;
+  }
+
+  throw network_error( "epoll_ctl()" );
+}
+
+bool Reactor_epoll_impl::poll(HandlerStateList& out, Reactor_base::Timeout to_ms)
+{
+  Impl::Event_vec& evs = impl->events;
+  int code = 0;
+
+  do {
+    code = epoll_wait( impl->epfd, &evs[0], static_cast<int>(evs.size()), to_ms );
+
+    if( code < 0 )
+    {
+      if (errno == EINTR)
+        continue;
+
+      throw network_error( "epoll_wait()" );
+    }
+
+    if( !code )
+      return false;
+
+  } while (code < 0);
+
+  for( int i = 0; i < code; i++ )
+  {
+    unsigned revents = evs[i].events;
+    Reactor_base::HandlerState hs(evs[i].data.fd);
+    hs.revents |= revents & EPOLLIN  ? Reactor_base::INPUT : 0;
+    hs.revents |= revents & EPOLLOUT ? Reactor_base::OUTPUT : 0;
+    hs.revents |= revents & EPOLLERR ? Reactor_base::OUTPUT : 0;
+    hs.revents |= revents & EPOLLHUP ? Reactor_base::OUTPUT : 0;
+    out.push_back( hs );
+  }
+
+  // Let the next call take more events at once when this one was full.
+  if( static_cast<size_t>(code) == evs.size() && evs.size() < 4096 )
+    evs.resize( evs.size() * 2 );
+
+  return true;
+}
+
+#endif // HAVE_EPOLL
@@ -0,0 +1,36 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_reactor_epoll_impl_h_
+#define _iqxmlrpc_reactor_epoll_impl_h_
+
+#ifdef HAVE_EPOLL
+#include "reactor.h"
+
+#include <boost/utility.hpp>
+
+namespace iqnet
+{
+
+//! Reactor implementation helper based on epoll(7) facility.
+/*! Interest set lives in the kernel and changes only when
+    handler's mask actually changes, so each poll() call costs
+    O(ready descriptors) instead of O(registered descriptors).
+*/
+class LIBIQXMLRPC_API Reactor_epoll_impl: boost::noncopyable {
+  struct Impl;
+  Impl* impl;
+
+public:
+  Reactor_epoll_impl();
+  virtual ~Reactor_epoll_impl();
+
+  void update(Socket::Handler, short old_mask, short new_mask);
+  void prepare() {}
+  bool poll(Reactor_base::HandlerStateList& out, Reactor_base::Timeout);
+};
+
+} // namespace iqnet
+
+#endif // HAVE_EPOLL
+#endif
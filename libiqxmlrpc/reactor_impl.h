@@ -6,8 +6,15 @@
 
 #include "config.h"
 #include "reactor.h"
+#include "timer_wheel.h"
 
-#ifdef HAVE_POLL
+#if defined(HAVE_EPOLL)
+#include "reactor_epoll_impl.h"
+  namespace iqnet
+  {
+    typedef Reactor_epoll_impl ReactorImpl;
+  }
+#elif defined(HAVE_POLL)
 #include "reactor_poll_impl.h"
   namespace iqnet
   {
@@ -19,19 +26,23 @@
   {
     typedef Reactor_select_impl ReactorImpl;
   }
-#endif // HAVE_POLL
+#endif // HAVE_EPOLL
 
 #include <boost/utility.hpp>
 
 #include <assert.h>
-#include <map>
-#include <algorithm>
+#include <vector>
 
 namespace iqnet
 {
 
 //! The Reactor template class.
 //! Lock param can be either boost::mutex or iqnet::Null_lock.
+/*! Handlers are kept in a table indexed by socket handler,
+    user events (see fake_event()) are queued separately,
+    so neither registration nor user event dispatching
+    depends on number of registered handlers.
+*/
 template <class Lock>
 class Reactor: public Reactor_base, boost::noncopyable {
 public:
@@ -44,39 +55,57 @@ public:
 
   void fake_event( Event_handler*, Event_mask );
 
+  void set_timer( Event_handler*, unsigned ms );
+
   bool handle_events( Timeout ms = -1 );
 
+  char* read_buffer();
+
 private:
-  typedef typename Lock::scoped_lock        scoped_lock;
-  typedef std::map<Socket::Handler, Event_handler*> EventHandlersMap;
-  typedef EventHandlersMap::iterator        h_iterator;
-  typedef HandlerStateList::const_iterator  hs_const_iterator;
-  typedef HandlerStateList::iterator        hs_iterator;
-
-  size_t            size()  const { return handlers_states.size(); }
-  hs_const_iterator begin() const { return handlers_states.begin(); }
-  hs_iterator       begin()       { return handlers_states.begin(); }
-  hs_const_iterator end()   const { return handlers_states.end(); }
-  hs_iterator       end()         { return handlers_states.end(); }
+  typedef typename Lock::scoped_lock scoped_lock;
+
+  struct Handler_slot {
+    Event_handler* handler;
+    short          mask;
+    short          revents;
 
+    Handler_slot():
+      handler(0), mask(0), revents(0) {}
+  };
+
+  typedef std::vector<Handler_slot>    Handler_slots;
+  typedef std::vector<Socket::Handler> User_events;
+
+  Handler_slot* find_slot(Socket::Handler);
   Event_handler* find_handler(Socket::Handler);
-  hs_iterator find_handler_state(Event_handler*);
+  void release_slot(Handler_slot&);
 
   void handle_user_events();
   bool handle_system_events( Timeout );
+  bool handle_timers();
 
   void invoke_clients_handler( Event_handler*, HandlerState&, bool& terminate );
   void invoke_servers_handler( Event_handler*, HandlerState&, bool& terminate );
   void invoke_event_handler( HandlerState& );
+  void invoke_timeout_handler( const Timer_wheel::Expired& );
 
 private:
   Lock lock;
   ReactorImpl impl;
 
-  EventHandlersMap handlers;
-  HandlerStateList handlers_states;
-
+  Handler_slots slots;
+  User_events user_events;
+  size_t num_handlers;
   unsigned num_stoppers;
+  Timer_wheel timers;
+
+  // Allocated on first use.
+  std::vector<char> read_buf;
+
+  // Used by handle_events() only, kept to avoid per-call allocations.
+  User_events user_events_tmp;
+  HandlerStateList ready;
+  Timer_wheel::Expired_list expired;
 };
 
 
@@ -84,92 +113,133 @@ private:
 
 template <class Lock>
 Reactor<Lock>::Reactor():
+  num_handlers(0),
   num_stoppers(0)
 {
 }
 
 template <class Lock>
-typename Reactor<Lock>::hs_iterator
-Reactor<Lock>::find_handler_state(Event_handler* eh)
+typename Reactor<Lock>::Handler_slot*
+Reactor<Lock>::find_slot(Socket::Handler fd)
 {
-  return std::find(begin(), end(), HandlerState(eh->get_handler()));
+  size_t i = static_cast<size_t>(fd);
+
+  if( i >= slots.size() || !slots[i].handler )
+    return 0;
+
+  return &slots[i];
 }
 
 template <class Lock>
 iqnet::Event_handler* Reactor<Lock>::find_handler(Socket::Handler fd)
 {
   scoped_lock lk(lock);
-  h_iterator i = handlers.find(fd);
-  return i == handlers.end() ? NULL : i->second;
+  Handler_slot* slot = find_slot(fd);
+  return slot ? slot->handler : NULL;
+}
+
+template <class Lock>
+void Reactor<Lock>::release_slot(Handler_slot& slot)
+{
+  if (slot.handler->is_stopper())
+    num_stoppers--;
+
+  // Timer left in the wheel could fire for a handler
+  // registered later with the same socket.
+  timers.cancel( slot.handler->get_handler() );
+
+  num_handlers--;
+  slot = Handler_slot();
 }
 
 template <class Lock>
 void Reactor<Lock>::register_handler( Event_handler* eh, Event_mask mask )
 {
   scoped_lock lk(lock);
+  size_t fd = static_cast<size_t>(eh->get_handler());
 
-  if (eh->is_stopper())
-    num_stoppers++;
+  if( fd >= slots.size() )
+    slots.resize( fd + 1 );
 
-  Socket::Handler fd = eh->get_handler();
+  Handler_slot& slot = slots[fd];
 
-  if( handlers.find(fd) == handlers.end() )
-  {
-    handlers_states.push_back( HandlerState(fd, mask) );
-    handlers[fd] = eh;
-  }
-  else
+  if( !slot.handler )
   {
-    typename Reactor<Lock>::hs_iterator i = find_handler_state(eh);
-    i->mask |= mask;
+    num_handlers++;
+
+    if (eh->is_stopper())
+      num_stoppers++;
   }
+
+  short oldmask = slot.mask;
+  slot.handler = eh;
+  slot.mask |= mask;
+
+  if( slot.mask != oldmask )
+    impl.update( eh->get_handler(), oldmask, slot.mask );
 }
 
 template <class Lock>
 void Reactor<Lock>::unregister_handler( Event_handler* eh, Event_mask mask )
 {
   scoped_lock lk(lock);
-  hs_iterator i = find_handler_state( eh );
+  Handler_slot* slot = find_slot( eh->get_handler() );
 
-  if( i != end() )
-  {
-    int newmask = (i->mask &= !mask);
+  if( !slot )
+    return;
 
-    if( !newmask )
-    {
-      handlers.erase(eh->get_handler());
-      handlers_states.erase(i);
+  short oldmask = slot->mask;
+  slot->mask &= ~mask;
 
-      if (eh->is_stopper())
-        num_stoppers--;
-    }
-  }
+  if( slot->mask != oldmask )
+    impl.update( eh->get_handler(), oldmask, slot->mask );
+
+  if( !slot->mask )
+    release_slot( *slot );
 }
 
 template <class Lock>
 void Reactor<Lock>::unregister_handler( Event_handler* eh )
 {
   scoped_lock lk(lock);
-  h_iterator i = handlers.find(eh->get_handler());
+  Handler_slot* slot = find_slot( eh->get_handler() );
 
-  if( i != handlers.end() )
-  {
-    handlers.erase(i);
-    handlers_states.erase(find_handler_state(eh));
+  if( !slot )
+    return;
 
-    if (eh->is_stopper())
-      num_stoppers--;
-  }
+  impl.update( eh->get_handler(), slot->mask, 0 );
+  release_slot( *slot );
 }
 
 template <class Lock>
 void Reactor<Lock>::fake_event( Event_handler* eh, Event_mask mask )
 {
   scoped_lock lk(lock);
-  hs_iterator i = find_handler_state( eh );
+  Handler_slot* slot = find_slot( eh->get_handler() );
+
+  if( !slot )
+    return;
+
+  if( !slot->revents )
+    user_events.push_back( eh->get_handler() );
 
-  if( i != end() )
-    i->revents |= mask;
+  slot->revents |= mask;
+}
+
+template <class Lock>
+char* Reactor<Lock>::read_buffer()
+{
+  if( read_buf.empty() )
+    read_buf.resize( read_buffer_sz );
+
+  return &read_buf[0];
+}
+
+template <class Lock>
+void Reactor<Lock>::set_timer( Event_handler* eh, unsigned ms )
+{
+  scoped_lock lk(lock);
+  timers.set( eh, ms );
 }
 
 template <class Lock>
@@ -209,8 +279,10 @@ void Reactor<Lock>::invoke_event_handler( Reactor_base::HandlerState& hs )
 {
   bool terminate = false;
 
+  // Handler might be unregistered by one invoked earlier in this cycle.
   Event_handler* handler = find_handler(hs.fd);
-  assert(handler);
+  if( !handler )
+    return;
 
   if( handler->catch_in_reactor() )
     invoke_servers_handler( handler, hs, terminate );
@@ -224,70 +296,141 @@ void Reactor<Lock>::invoke_event_handler( Reactor_base::HandlerState& hs )
   }
 }
 
+template <class Lock>
+void Reactor<Lock>::invoke_timeout_handler( const Timer_wheel::Expired& ex )
+{
+  bool terminate = false;
+
+  // Timer of unregistered or replaced handler is dropped.
+  Event_handler* handler = find_handler(ex.fd);
+  if( handler != ex.handler )
+    return;
+
+  if( !handler->catch_in_reactor() )
+  {
+    handler->handle_timeout( terminate );
+  }
+  else
+  {
+    try {
+      handler->handle_timeout( terminate );
+    }
+    catch( const std::exception& e )
+    {
+      handler->log_exception( e );
+      terminate = true;
+    }
+    catch( ... )
+    {
+      handler->log_unknown_exception();
+      terminate = true;
+    }
+  }
+
+  if( terminate )
+  {
+    unregister_handler( handler );
+    handler->finish();
+  }
+}
+
 template <class Lock>
 void Reactor<Lock>::handle_user_events()
 {
-  HandlerStateList called_by_user;
   scoped_lock lk(lock);
 
-  for( hs_iterator i = begin(); i != end(); ++i )
+  if( user_events.empty() )
+    return;
+
+  user_events_tmp.swap( user_events );
+  ready.clear();
+
+  for( size_t i = 0; i < user_events_tmp.size(); ++i )
   {
-    if( i->revents && (i->mask | i->revents) )
+    Handler_slot* slot = find_slot( user_events_tmp[i] );
+
+    if( slot && slot->revents )
     {
-      called_by_user.push_back( *i );
-      i->revents &= !i->mask;
+      HandlerState hs( user_events_tmp[i] );
+      hs.revents = slot->revents;
+      ready.push_back( hs );
+      slot->revents = 0;
     }
   }
 
+  user_events_tmp.clear();
   lk.unlock();
 
-  while( !called_by_user.empty() )
-  {
-    HandlerState hs(called_by_user.front());
-    called_by_user.pop_front();
-    invoke_event_handler(hs);
-  }
+  for( size_t i = 0; i < ready.size(); ++i )
+    invoke_event_handler( ready[i] );
 }
 
 template <class Lock>
 bool Reactor<Lock>::handle_system_events(Reactor_base::Timeout ms)
 {
   scoped_lock lk(lock);
-  HandlerStateList tmp(handlers_states);
-  lk.unlock();
 
   // if all events were of "user" type
-  if (tmp.empty())
+  if (!num_handlers)
     return true;
 
-  impl.reset(tmp);
-  HandlerStateList ret;
-  bool succ = impl.poll(ret, ms);
+  impl.prepare();
+  lk.unlock();
+
+  ready.clear();
+  bool succ = impl.poll(ready, ms);
 
   if (!succ)
     return false;
 
-  while (!ret.empty())
-  {
-    HandlerState hs(ret.front());
-    ret.pop_front();
-    invoke_event_handler(hs);
-  }
+  for( size_t i = 0; i < ready.size(); ++i )
+    invoke_event_handler( ready[i] );
 
   return true;
 }
 
+template <class Lock>
+bool Reactor<Lock>::handle_timers()
+{
+  scoped_lock lk(lock);
+
+  if( timers.empty() )
+    return false;
+
+  expired.clear();
+  timers.expire( expired );
+  lk.unlock();
+
+  for( size_t i = 0; i < expired.size(); ++i )
+    invoke_timeout_handler( expired[i] );
+
+  return !expired.empty();
+}
+
 template <class Lock>
 bool Reactor<Lock>::handle_events(Reactor_base::Timeout ms)
 {
-  if (handlers.empty())
+  if (!num_handlers)
     return false;
 
-  if (handlers.size() - num_stoppers <= 0)
+  if (num_handlers <= num_stoppers)
     throw No_handlers();
 
   handle_user_events();
-  return handle_system_events(ms);
+
+  // Do not sleep past the nearest timer.
+  Timeout wait = ms;
+  {
+    scoped_lock lk(lock);
+    Timeout tm = timers.next_timeout();
+
+    if( tm >= 0 && (wait < 0 || tm < wait) )
+      wait = tm;
+  }
+
+  bool succ = handle_system_events(wait);
+  bool fired = handle_timers();
+  return succ || fired || wait != ms;
 }
 
 } // namespace iqnet
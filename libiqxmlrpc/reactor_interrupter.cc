@@ -1,6 +1,7 @@
 //  Libiqxmlrpc - an object-oriented XML-RPC solution.
 //  Copyright (C) 2011 Anton Dedov
 
+#include "config.h"
 #include "reactor_interrupter.h"
 #include "connection.h"
 #include "lock.h"
@@ -9,10 +10,148 @@
 #include <boost/optional.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include <algorithm>
 #include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#include <stdint.h>
+#endif
 
 namespace iqnet {
 
+namespace {
+
+typedef std::pair<Event_handler*, Reactor_base::Event_mask> Posted_event;
+typedef std::vector<Posted_event> Posted_events;
+
+struct Posted_to {
+  Event_handler* handler;
+
+  Posted_to(Event_handler* h): handler(h) {}
+
+  bool operator ()(const Posted_event& e) const
+  {
+    return e.first == handler;
+  }
+};
+
+void cancel_posted(Posted_events& events, Event_handler* handler)
+{
+  events.erase(
+    std::remove_if(events.begin(), events.end(), Posted_to(handler)),
+    events.end());
+}
+
+void deliver_posted(Reactor_base* reactor, const Posted_events& events)
+{
+  for (size_t i = 0; i < events.size(); ++i)
+    reactor->fake_event(events[i].first, events[i].second);
+}
+
+} // anonymous namespace
+
+#ifdef HAVE_EVENTFD
+
+//! Interrupter based on eventfd(2) object.
+/*! Interrupts requested until reactor wakes up
+    are coalesced into single write to the eventfd. */
+class Reactor_interrupter::Impl: public Event_handler, boost::noncopyable {
+public:
+  Impl(Reactor_base* reactor);
+  ~Impl();
+
+  void make_interrupt();
+  void post_event(Event_handler*, Reactor_base::Event_mask);
+  void cancel_events(Event_handler*);
+
+  bool is_stopper() const { return true; }
+  Socket::Handler get_handler() const { return fd_; }
+  void handle_input(bool& /* terminate */);
+
+private:
+  void interrupt();
+
+  Reactor_base* reactor_;
+  int fd_;
+  bool pending_;
+  Posted_events posted_;
+  Posted_events delivering_;
+  boost::mutex lock_;
+};
+
+
+Reactor_interrupter::Impl::Impl(Reactor_base* reactor):
+  reactor_(reactor),
+  fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+  pending_(false)
+{
+  if (fd_ == -1)
+    throw network_error("eventfd");
+
+  reactor_->register_handler(this, Reactor_base::INPUT);
+}
+
+Reactor_interrupter::Impl::~Impl()
+{
+  reactor_->unregister_handler(this);
+  ::close(fd_);
+}
+
+void Reactor_interrupter::Impl::handle_input(bool&)
+{
+  uint64_t counter;
+  ssize_t ret = ::read(fd_, &counter, sizeof(counter));
+  (void)ret;
+
+  // Reactor is awake now, so everything registered before
+  // this point will be noticed without another interrupt.
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    pending_ = false;
+    delivering_.swap(posted_);
+  }
+
+  deliver_posted(reactor_, delivering_);
+  delivering_.clear();
+}
+
+void Reactor_interrupter::Impl::interrupt()
+{
+  if (pending_)
+    return;
+
+  const uint64_t one = 1;
+  if (::write(fd_, &one, sizeof(one)) == -1 && errno != EAGAIN)
+    throw network_error("Reactor_interrupter");
+
+  pending_ = true;
+}
+
+void Reactor_interrupter::Impl::make_interrupt()
+{
+  boost::mutex::scoped_lock lk(lock_);
+  interrupt();
+}
+
+void Reactor_interrupter::Impl::post_event(
+  Event_handler* eh, Reactor_base::Event_mask mask)
+{
+  boost::mutex::scoped_lock lk(lock_);
+  posted_.push_back(Posted_event(eh, mask));
+  interrupt();
+}
+
+void Reactor_interrupter::Impl::cancel_events(Event_handler* eh)
+{
+  boost::mutex::scoped_lock lk(lock_);
+  cancel_posted(posted_, eh);
+}
+
+#else // HAVE_EVENTFD
+
 class Interrupter_connection: public Connection {
 public:
   Interrupter_connection(Reactor_base* r, const Socket& sock):
@@ -33,19 +172,53 @@ public:
   {
     char nothing;
     recv(&nothing, 1);
+
+    {
+      boost::mutex::scoped_lock lk(lock_);
+      delivering_.swap(posted_);
+    }
+
+    deliver_posted(reactor_, delivering_);
+    delivering_.clear();
+  }
+
+  void post_event(Event_handler* eh, Reactor_base::Event_mask mask)
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    posted_.push_back(Posted_event(eh, mask));
+  }
+
+  void cancel_events(Event_handler* eh)
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    cancel_posted(posted_, eh);
   }
 
 private:
   Reactor_base* reactor_;
+  Posted_events posted_;
+  Posted_events delivering_;
+  boost::mutex lock_;
 };
 
 class Reactor_interrupter::Impl: boost::noncopyable {
 public:
   Impl(Reactor_base* reactor);
-  ~Impl() {}
+  ~Impl() { client_.close(); }
 
   void make_interrupt();
 
+  void post_event(Event_handler* eh, Reactor_base::Event_mask mask)
+  {
+    server_->post_event(eh, mask);
+    make_interrupt();
+  }
+
+  void cancel_events(Event_handler* eh)
+  {
+    server_->cancel_events(eh);
+  }
+
 private:
   std::auto_ptr<Interrupter_connection> server_;
   Socket client_;
@@ -62,6 +235,7 @@ Reactor_interrupter::Impl::Impl(Reactor_base* reactor)
   Inet_addr srv_addr(srv.get_addr());
   client_.connect( Inet_addr("127.0.0.1", srv_addr.get_port()) );
   Socket srv_conn(srv.accept());
+  srv.close();
 
   server_.reset(new Interrupter_connection(reactor, srv_conn));
 }
@@ -72,6 +246,8 @@ void Reactor_interrupter::Impl::make_interrupt()
   client_.send("\0", 1);
 }
 
+#endif // HAVE_EVENTFD
+
 
 Reactor_interrupter::Reactor_interrupter(Reactor_base* r):
   impl_(new Impl(r))
@@ -88,4 +264,15 @@ void Reactor_interrupter::make_interrupt()
   impl_->make_interrupt();
 }
 
+void Reactor_interrupter::post_event(
+  Event_handler* eh, Reactor_base::Event_mask mask)
+{
+  impl_->post_event(eh, mask);
+}
+
+void Reactor_interrupter::cancel_events(Event_handler* eh)
+{
+  impl_->cancel_events(eh);
+}
+
 } // namespace iqnet
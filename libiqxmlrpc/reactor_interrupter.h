@@ -22,6 +22,13 @@ public:
 
   void make_interrupt();
 
+  //! Deliver user event (see Reactor_base::fake_event()) to handler
+  //! in reactor's thread. May be called from any thread.
+  void post_event(Event_handler*, Reactor_base::Event_mask);
+
+  //! Drop events posted to handler which is going to be destroyed.
+  void cancel_events(Event_handler*);
+
 private:
   class Impl;
   Impl* impl_;
@@ -6,7 +6,6 @@
 #ifdef HAVE_POLL
 #include "reactor_poll_impl.h"
 
-#include <deque>
 #include <sys/poll.h>
 #include <vector>
 
@@ -16,9 +15,31 @@ typedef Reactor_base::HandlerStateList HandlerStateList;
 
 struct Reactor_poll_impl::Impl {
   typedef std::vector<struct pollfd> Pollfd_vec;
+  typedef std::vector<size_t> Index_vec;
+
+  // Position of descriptor's entry in states, indexed by descriptor.
+  Pollfd_vec states;
+  Index_vec index;
   Pollfd_vec pfd;
+  bool dirty;
+
+  Impl():
+    dirty(false)
+  {
+  }
 };
 
+namespace {
+
+inline short poll_events(short mask)
+{
+  short events = mask & Reactor_base::INPUT ? POLLIN : 0;
+  events |= mask & Reactor_base::OUTPUT ? POLLOUT : 0;
+  return events;
+}
+
+} // anonymous namespace
+
 Reactor_poll_impl::Reactor_poll_impl():
   impl(new Impl)
 {
@@ -29,23 +50,58 @@ Reactor_poll_impl::~Reactor_poll_impl()
   delete impl;
 }
 
-void Reactor_poll_impl::reset(const HandlerStateList& in)
+void Reactor_poll_impl::update(Socket::Handler fd, short old_mask, short new_mask)
 {
-  impl->pfd.clear();
+  impl->dirty = true;
+
+  size_t ufd = static_cast<size_t>(fd);
+
+  if( !old_mask )
+  {
+    struct pollfd sfd = { fd, poll_events(new_mask), 0 };
 
-  for( HandlerStateList::const_iterator i = in.begin(); i != in.end(); ++i )
+    if( ufd >= impl->index.size() )
+      impl->index.resize( ufd + 1 );
+
+    impl->index[ufd] = impl->states.size();
+    impl->states.push_back( sfd );
+    return;
+  }
+
+  if( ufd >= impl->index.size() )
+    return;
+
+  size_t pos = impl->index[ufd];
+  if( new_mask )
+  {
+    impl->states[pos].events = poll_events(new_mask);
+    return;
+  }
+
+  // Move the last entry into the vacant place.
+  if( pos != impl->states.size() - 1 )
   {
-    short events = i->mask & Reactor_base::INPUT ? POLLIN : 0;
-    events |= i->mask & Reactor_base::OUTPUT ? POLLOUT : 0;
-    struct pollfd sfd = { i->fd, events, 0 };
-    impl->pfd.push_back( sfd );
+    impl->states[pos] = impl->states.back();
+    impl->index[impl->states[pos].fd] = pos;
   }
+  impl->states.pop_back();
+}
+
+void Reactor_poll_impl::prepare()
+{
+  if( !impl->dirty )
+    return;
+
+  impl->pfd = impl->states;
+  impl->dirty = false;
 }
 
 bool Reactor_poll_impl::poll(HandlerStateList& out, Reactor_base::Timeout to_ms)
 {
+  int code = 0;
+
   do {
-    int code = ::poll( &impl->pfd[0], impl->pfd.size(), to_ms );
+    code = ::poll( &impl->pfd[0], impl->pfd.size(), to_ms );
 
     if( code < 0 )
     {
@@ -58,7 +114,7 @@ bool Reactor_poll_impl::poll(HandlerStateList& out, Reactor_base::Timeout to_ms)
     if( !code )
       return false;
 
-  } while (false);
+  } while (code < 0);
 
   for( unsigned i = 0; i < impl->pfd.size(); i++ )
   {
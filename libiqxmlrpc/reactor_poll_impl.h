@@ -21,7 +21,8 @@ public:
   Reactor_poll_impl();
   virtual ~Reactor_poll_impl();
 
-  void reset(const Reactor_base::HandlerStateList&);
+  void update(Socket::Handler, short old_mask, short new_mask);
+  void prepare();
   bool poll(Reactor_base::HandlerStateList& out, Reactor_base::Timeout);
 };
 
@@ -6,11 +6,14 @@
 #ifndef HAVE_POLL
 #include "reactor_select_impl.h"
 
+#include <algorithm>
+
 using namespace iqnet;
 
 typedef Reactor_base::HandlerStateList HandlerStateList;
 
-Reactor_select_impl::Reactor_select_impl()
+Reactor_select_impl::Reactor_select_impl():
+  dirty(false)
 {
 }
 
@@ -18,15 +21,44 @@ Reactor_select_impl::~Reactor_select_impl()
 {
 }
 
-void Reactor_select_impl::reset(const HandlerStateList& in)
+void Reactor_select_impl::update(Socket::Handler fd, short old_mask, short new_mask)
 {
-  hs = in;
+  dirty = true;
+
+  if( !old_mask )
+  {
+    Reactor_base::HandlerState h( fd );
+    h.mask = new_mask;
+    states.push_back( h );
+    return;
+  }
+
+  HandlerStateList::iterator i =
+    std::find( states.begin(), states.end(), Reactor_base::HandlerState(fd) );
+
+  if( i == states.end() )
+    return;
+
+  if( new_mask )
+    i->mask = new_mask;
+  else
+    states.erase( i );
+}
+
+void Reactor_select_impl::prepare()
+{
+  if( dirty )
+  {
+    hs = states;
+    dirty = false;
+  }
+
   max_fd = 0;
   FD_ZERO( &read_set );
   FD_ZERO( &write_set );
   FD_ZERO( &err_set );
 
-  for( HandlerStateList::const_iterator i = in.begin(); i != in.end(); ++i )
+  for( HandlerStateList::const_iterator i = hs.begin(); i != hs.end(); ++i )
   {
     if( i->mask & Reactor_base::INPUT )
       FD_SET( i->fd, &read_set );
@@ -50,8 +82,10 @@ bool Reactor_select_impl::poll(HandlerStateList& out, Reactor_base::Timeout to_m
     ptv = &tv;
   }
 
+  int code = 0;
+
   do {
-    int code = ::select( static_cast<int>(max_fd+1), &read_set, &write_set, &err_set, ptv );
+    code = ::select( static_cast<int>(max_fd+1), &read_set, &write_set, &err_set, ptv );
 
     if( code < 0 )
     {
@@ -64,7 +98,7 @@ bool Reactor_select_impl::poll(HandlerStateList& out, Reactor_base::Timeout to_m
     if( !code )
       return false;
 
-  } while (false);
+  } while (code < 0);
 
   for( HandlerStateList::const_iterator i = hs.begin(); i != hs.end(); ++i )
   {
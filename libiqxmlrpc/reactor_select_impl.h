@@ -22,13 +22,16 @@ namespace iqnet
 class LIBIQXMLRPC_API Reactor_select_impl: boost::noncopyable {
   Socket::Handler max_fd;
   fd_set read_set, write_set, err_set;
+  Reactor_base::HandlerStateList states;
   Reactor_base::HandlerStateList hs;
+  bool dirty;
 
 public:
   Reactor_select_impl();
   virtual ~Reactor_select_impl();
 
-  void reset(const Reactor_base::HandlerStateList&);
+  void update(Socket::Handler, short old_mask, short new_mask);
+  void prepare();
   bool poll(Reactor_base::HandlerStateList& out, Reactor_base::Timeout);
 };
 
@@ -23,31 +23,43 @@ RequestBuilder::RequestBuilder(Parser& parser):
   state_(parser, NONE)
 {
   static const StateMachine::StateTransition trans[] = {
-    { NONE, METHOD_CALL, "methodCall" },
-    { METHOD_CALL, METHOD_NAME, "methodName" },
-    { METHOD_NAME, PARAMS, "params" },
-    { PARAMS, PARAM, "param" },
-    { PARAM, VALUE, "value" },
-    { VALUE, PARAM, "param" },
-    { 0, 0, 0 }
+    { NONE, METHOD_CALL, TAG_METHOD_CALL },
+    { METHOD_CALL, METHOD_NAME, TAG_METHOD_NAME },
+    { METHOD_NAME, PARAMS, TAG_PARAMS },
+    { PARAMS, PARAM, TAG_PARAM },
+    { PARAM, VALUE, TAG_VALUE },
+    { VALUE, PARAM, TAG_PARAM },
+    { 0, 0, TAG_UNKNOWN }
   };
   state_.set_transitions(trans);
 }
 
 void
-RequestBuilder::do_visit_element(const std::string& tagname)
+RequestBuilder::do_visit_element(XmlRpcTag tag)
 {
-  switch (state_.change(tagname)) {
+  switch (state_.change(tag)) {
   case METHOD_NAME:
-    method_name_ = parser_.get_data();
+    want_data();
     break;
 
   case VALUE:
-    params_.push_back(sub_build<Value_type*, ValueBuilder>(true));
+    sub_build<ValueBuilder>(true);
     break;
   }
 }
 
+void
+RequestBuilder::do_visit_data(const std::string& data)
+{
+  method_name_ = data;
+}
+
+void
+RequestBuilder::do_visit_sub_build(BuilderBase& b)
+{
+  params_.push_back(static_cast<ValueBuilder&>(b).result());
+}
+
 Request*
 RequestBuilder::get()
 {
@@ -57,4 +69,74 @@ RequestBuilder::get()
   return new Request(method_name_.get(), params_);
 }
 
+//
+// Request_reader
+//
+
+Request_reader::Request_reader():
+  builder_(parser_),
+  err_(ERR_NONE),
+  err_code_(0)
+{
+}
+
+void
+Request_reader::feed(const char* s, size_t len)
+{
+  do_feed(s, len, false);
+}
+
+void
+Request_reader::feed(const std::string& s)
+{
+  do_feed(s.data(), s.length(), false);
+}
+
+void
+Request_reader::do_feed(const char* s, size_t len, bool last)
+{
+  if (err_ == ERR_PARSE)
+    return;
+
+  try {
+    builder_.feed(s, len, last);
+  }
+  catch (const Parse_error& e) {
+    err_ = ERR_PARSE;
+    err_msg_ = e.what();
+    err_code_ = e.code();
+  }
+  catch (const Exception& e) {
+    if (err_ == ERR_NONE) {
+      err_ = ERR_LIBRARY;
+      err_msg_ = e.what();
+      err_code_ = e.code();
+    }
+  }
+  catch (const std::exception& e) {
+    if (err_ == ERR_NONE) {
+      err_ = ERR_STD;
+      err_msg_ = e.what();
+    }
+  }
+}
+
+Request*
+Request_reader::get()
+{
+  do_feed(0, 0, true);
+
+  switch (err_) {
+  case ERR_PARSE:
+  case ERR_LIBRARY:
+    throw Exception(err_msg_, err_code_);
+
+  case ERR_STD:
+    throw std::runtime_error(err_msg_);
+
+  default:
+    return builder_.get();
+  }
+}
+
 } // namespace iqxmlrpc
@@ -19,13 +19,49 @@ public:
 
 private:
   virtual void
-  do_visit_element(const std::string&);
+  do_visit_element(XmlRpcTag);
+
+  virtual void
+  do_visit_data(const std::string&);
+
+  virtual void
+  do_visit_sub_build(BuilderBase&);
 
   StateMachine state_;
   boost::optional<std::string> method_name_;
   Param_list params_;
 };
 
+//! Builds request from body received in parts.
+/*! Errors are kept until get() is called, so that the rest of body
+    can still be fed. Parse error of later part supersedes them. */
+class Request_reader {
+public:
+  Request_reader();
+
+  void
+  feed(const char*, size_t);
+
+  void
+  feed(const std::string&);
+
+  //! Finish body. Throws the first error, or parse error if any.
+  Request*
+  get();
+
+private:
+  enum Error_kind { ERR_NONE, ERR_PARSE, ERR_LIBRARY, ERR_STD };
+
+  void
+  do_feed(const char*, size_t, bool last);
+
+  Parser parser_;
+  RequestBuilder builder_;
+  Error_kind err_;
+  std::string err_msg_;
+  int err_code_;
+};
+
 } // namespace iqxmlrpc
 
 #endif
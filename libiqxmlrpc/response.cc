@@ -22,10 +22,11 @@ parse_response( const std::string& response_string )
   return builder.get();
 }
 
-std::string
-dump_response( const Response& response )
+namespace {
+
+void
+build_response( XmlBuilder& writer, const Response& response )
 {
-  XmlBuilder writer;
   XmlBuilder::Node root(writer, "methodResponse");
   Value_type_to_xml value_xml_visitor(writer, true);
 
@@ -40,11 +41,51 @@ dump_response( const Response& response )
     fault.insert( "faultString", response.fault_string() );
     Value(fault).apply_visitor(value_xml_visitor);
   }
+}
+
+//! Collects parts into vector.
+class Parts_writer: public Response_writer {
+public:
+  Parts_writer(std::vector<std::string>& p):
+    parts(p) {}
 
+  void
+  write_part(std::string& s)
+  {
+    parts.push_back(std::string());
+    parts.back().swap(s);
+  }
+
+private:
+  std::vector<std::string>& parts;
+};
+
+} // anonymous namespace
+
+std::string
+dump_response( const Response& response )
+{
+  XmlBuilder writer;
+  build_response(writer, response);
   writer.stop();
   return writer.content();
 }
 
+void
+dump_response( const Response& response, std::vector<std::string>& parts, size_t part_sz )
+{
+  Parts_writer out(parts);
+  dump_response(response, out, part_sz);
+}
+
+void
+dump_response( const Response& response, Response_writer& out, size_t part_sz )
+{
+  XmlBuilder writer(out, part_sz);
+  build_response(writer, response);
+  writer.stop();
+}
+
 //
 // Response
 //
@@ -6,6 +6,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <string>
+#include <vector>
 #include "api_export.h"
 
 namespace iqxmlrpc {
@@ -24,6 +25,26 @@ LIBIQXMLRPC_API Response parse_response( const std::string& );
 //! Dump response to XML.
 LIBIQXMLRPC_API std::string dump_response( const Response& );
 
+//! Dump response to XML split into parts of about specified size.
+/*! Avoids keeping whole document in one buffer and copying it,
+    all parts are still produced before the function returns. */
+LIBIQXMLRPC_API void dump_response(
+  const Response&, std::vector<std::string>& parts, size_t part_sz );
+
+//! Receiver of response XML which is passed in parts as it is built.
+class LIBIQXMLRPC_API Response_writer {
+public:
+  virtual ~Response_writer() {}
+
+  //! Take next part of document. May grab its content.
+  virtual void write_part( std::string& ) = 0;
+};
+
+//! Dump response to XML passing every part of about specified size
+//! to the writer as soon as it is built.
+LIBIQXMLRPC_API void dump_response(
+  const Response&, Response_writer&, size_t part_sz );
+
 //! XML-RPC response.
 class LIBIQXMLRPC_API Response {
 public:
@@ -23,43 +23,54 @@ ResponseBuilder::ResponseBuilder(Parser& parser):
   state_(parser, NONE)
 {
   static const StateMachine::StateTransition trans[] = {
-    { NONE, RESPONSE, "methodResponse" },
-    { RESPONSE, OK_RESPONSE, "params" },
-    { OK_RESPONSE, OK_PARAM, "param" },
-    { OK_PARAM, OK_PARAM_VALUE, "value" },
-    { RESPONSE, FAULT_RESPONSE, "fault" },
-    { FAULT_RESPONSE, FAULT_RESPONSE_VALUE, "value" },
-    { 0, 0, 0 }
+    { NONE, RESPONSE, TAG_METHOD_RESPONSE },
+    { RESPONSE, OK_RESPONSE, TAG_PARAMS },
+    { OK_RESPONSE, OK_PARAM, TAG_PARAM },
+    { OK_PARAM, OK_PARAM_VALUE, TAG_VALUE },
+    { RESPONSE, FAULT_RESPONSE, TAG_FAULT },
+    { FAULT_RESPONSE, FAULT_RESPONSE_VALUE, TAG_VALUE },
+    { 0, 0, TAG_UNKNOWN }
   };
   state_.set_transitions(trans);
 }
 
 void
-ResponseBuilder::do_visit_element(const std::string& tagname)
+ResponseBuilder::do_visit_element(XmlRpcTag tag)
 {
-  switch (state_.change(tagname)) {
+  switch (state_.change(tag)) {
   case OK_PARAM_VALUE:
-    parse_ok();
+    sub_build<ValueBuilder>(true);
     break;
 
   case FAULT_RESPONSE_VALUE:
-    parse_fault();
+    sub_build<ValueBuilder>();
     break;
   }
 }
 
 void
-ResponseBuilder::parse_ok()
+ResponseBuilder::do_visit_sub_build(BuilderBase& b)
 {
-  ok_ = sub_build<Value_type*, ValueBuilder>(true);
+  Value_type* v = static_cast<ValueBuilder&>(b).result();
+
+  if (state_.get_state() == OK_PARAM_VALUE)
+    parse_ok(v);
+  else
+    parse_fault(v);
+}
+
+void
+ResponseBuilder::parse_ok(Value_type* v)
+{
+  ok_ = v;
 }
 
 void
-ResponseBuilder::parse_fault()
+ResponseBuilder::parse_fault(Value_type* fault)
 {
   static const char* fcode = "faultCode";
   static const char* fstr = "faultString";
-  Value v = sub_build<Value_type*, ValueBuilder>();
+  Value v = fault;
 
   if (!v.is_struct())
     throw XML_RPC_violation(parser_.context());
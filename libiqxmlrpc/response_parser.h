@@ -20,13 +20,16 @@ public:
 
 private:
   virtual void
-  do_visit_element(const std::string&);
+  do_visit_element(XmlRpcTag);
+
+  virtual void
+  do_visit_sub_build(BuilderBase&);
 
   void
-  parse_ok();
+  parse_ok(Value_type*);
 
   void
-  parse_fault();
+  parse_fault(Value_type*);
 
   StateMachine state_;
   boost::optional<Value> ok_;
@@ -1,42 +1,134 @@
 //  Libiqxmlrpc - an object-oriented XML-RPC solution.
 //  Copyright (C) 2011 Anton Dedov
 
+#include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include <memory>
+#include <vector>
 
+#include "config.h"
 #include "server.h"
+#include "auth_cache.h"
 #include "auth_plugin.h"
+#include "conn_limiter.h"
 #include "http_errors.h"
 #include "reactor.h"
 #include "reactor_interrupter.h"
 #include "request.h"
 #include "response.h"
 #include "server_conn.h"
+#include "util.h"
 #include "xheaders.h"
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace iqxmlrpc {
 
+//! Reactor accompanied with its interrupter and acceptor.
+/*! In shard mode it also owns executor factory, copy of method
+    dispatchers, connection limiter and auth cache used for
+    connections it serves. */
+struct Server_reactor: boost::noncopyable {
+  std::auto_ptr<Executor_factory_base>      shard_exec_factory;
+  std::auto_ptr<Method_dispatcher_manager>  shard_disp_manager;
+  boost::scoped_ptr<iqnet::Conn_limiter>    shard_conn_limiter;
+  boost::scoped_ptr<Auth_cache>             shard_auth_cache;
+  std::auto_ptr<iqnet::Reactor_base>        reactor;
+  std::auto_ptr<iqnet::Reactor_interrupter> interrupter;
+  std::auto_ptr<iqnet::Acceptor>            acceptor;
+
+  Server_reactor(iqnet::Reactor_base* r, Executor_factory_base* ef = 0):
+    shard_exec_factory(ef),
+    reactor(r),
+    interrupter(new iqnet::Reactor_interrupter(r)),
+    acceptor(0)
+  {
+  }
+};
+
+namespace {
+
+//! Bind calling thread to n-th CPU of ones it is allowed to run on.
+void pin_to_cpu(unsigned n)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed))
+    return;
+
+  int count = CPU_COUNT(&allowed);
+  if (!count)
+    return;
+
+  n %= count;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+  {
+    if (!CPU_ISSET(cpu, &allowed) || n--)
+      continue;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    return;
+  }
+#else
+  (void)n;
+#endif
+}
+
+} // anonymous namespace
+
 class Server::Impl {
 public:
+  typedef std::vector<Server_reactor*> Reactors;
+
   Executor_factory_base* exec_factory;
 
   iqnet::Inet_addr bind_addr;
 
-  std::auto_ptr<iqnet::Reactor_base>          reactor;
-  std::auto_ptr<iqnet::Reactor_interrupter>   interrupter;
+  Reactors reactors;
+  unsigned num_reactors;
+  bool sharded;
   std::auto_ptr<iqnet::Accepted_conn_factory> conn_factory;
-  std::auto_ptr<iqnet::Acceptor>              acceptor;
   iqnet::Firewall_base* firewall;
-
-  bool exit_flag;
+  unsigned backlog;
+  unsigned accept_budget;
+  unsigned defer_accept;
+  iqnet::Socket_options sock_opts;
+  iqnet::Conn_limiter conn_limiter;
+  size_t max_conns;
+  size_t conns_low_watermark;
+  size_t max_conns_per_ip;
+
+  util::LockedBool<boost::mutex> exit_flag;
+  boost::mutex log_lock;
   std::ostream* log;
   size_t max_req_sz;
   http::Verification_level ver_level;
+  unsigned idle_timeout;
+  unsigned header_timeout;
+  unsigned body_timeout;
+  unsigned max_requests_per_conn;
+  unsigned max_pipelined;
+  size_t compression_threshold;
+  size_t response_chunk_sz;
 
   Method_dispatcher_manager  disp_manager;
   std::auto_ptr<Interceptor> interceptors;
   const Auth_Plugin_base*    auth_plugin;
+  boost::scoped_ptr<Auth_cache> auth_cache;
+  size_t auth_cache_sz;
+  unsigned auth_cache_ttl;
+
+  boost::mutex error_lock;
+  std::string  error;
 
   Impl(
     const iqnet::Inet_addr& addr,
@@ -44,21 +136,161 @@ public:
     Executor_factory_base* ef):
       exec_factory(ef),
       bind_addr(addr),
-      reactor(ef->create_reactor()),
-      interrupter(new iqnet::Reactor_interrupter(reactor.get())),
+      num_reactors(1),
+      sharded(false),
       conn_factory(cf),
-      acceptor(0),
       firewall(0),
+      backlog(100),
+      accept_budget(0),
+      defer_accept(0),
+      max_conns(0),
+      conns_low_watermark(0),
+      max_conns_per_ip(0),
       exit_flag(false),
       log(0),
       max_req_sz(0),
       ver_level(http::HTTP_CHECK_WEAK),
+      idle_timeout(0),
+      header_timeout(0),
+      body_timeout(0),
+      max_requests_per_conn(0),
+      max_pipelined(1),
+      compression_threshold(0),
+      response_chunk_sz(0),
       interceptors(0),
-      auth_plugin(0)
+      auth_plugin(0),
+      auth_cache_sz(0),
+      auth_cache_ttl(0)
+  {
+    reactors.push_back(new Server_reactor(ef->create_reactor()));
+  }
+
+  ~Impl()
   {
+    util::delete_ptrs(reactors.begin(), reactors.end());
   }
+
+  Server_reactor* find_reactor(iqnet::Reactor_base*);
+  void start_shards();
+  void start_acceptors(Server*);
+  void run_reactor(Server_reactor*);
+  void run_reactor_thread(Server*, Server_reactor*, unsigned cpu);
 };
 
+Server_reactor* Server::Impl::find_reactor(iqnet::Reactor_base* reactor)
+{
+  for (Reactors::iterator i = reactors.begin(); i != reactors.end(); ++i)
+  {
+    if ((*i)->reactor.get() == reactor)
+      return *i;
+  }
+
+  return 0;
+}
+
+void Server::Impl::start_shards()
+{
+  while (reactors.size() < num_reactors)
+  {
+    std::auto_ptr<Executor_factory_base> ef(new Serial_executor_factory);
+    iqnet::Reactor_base* r = ef->create_reactor();
+    reactors.push_back(new Server_reactor(r, ef.release()));
+  }
+
+  for (Reactors::iterator i = reactors.begin(); i != reactors.end(); ++i)
+  {
+    Server_reactor& r = **i;
+    if (!r.shard_exec_factory.get())
+      r.shard_exec_factory.reset(new Serial_executor_factory);
+
+    // Take fresh copy as methods may be registered between work() calls.
+    r.shard_disp_manager.reset(disp_manager.clone());
+
+    // Limits are split between shards, per IP one applies to each shard.
+    size_t n = reactors.size();
+    if (!r.shard_conn_limiter)
+      r.shard_conn_limiter.reset(new iqnet::Conn_limiter);
+
+    r.shard_conn_limiter->set_max_connections(
+      (max_conns + n - 1) / n, conns_low_watermark / n);
+    r.shard_conn_limiter->set_max_connections_per_ip(max_conns_per_ip);
+
+    r.shard_auth_cache.reset(auth_cache_sz ?
+      new Auth_cache((auth_cache_sz + n - 1) / n, auth_cache_ttl) : 0);
+  }
+}
+
+void Server::Impl::start_acceptors(Server* server)
+{
+  if (sharded)
+    start_shards();
+
+  while (reactors.size() < num_reactors)
+    reactors.push_back(new Server_reactor(exec_factory->create_reactor()));
+
+  bool reuse_port = reactors.size() > 1;
+  iqnet::Inet_addr addr = bind_addr;
+
+  for (Reactors::iterator i = reactors.begin(); i != reactors.end(); ++i)
+  {
+    Server_reactor& r = **i;
+    if (r.acceptor.get())
+      continue;
+
+    r.acceptor.reset(new iqnet::Acceptor(
+      addr, server->get_conn_factory(), r.reactor.get(), reuse_port, backlog));
+    r.acceptor->set_firewall(firewall);
+    r.acceptor->set_accept_budget(accept_budget);
+    r.acceptor->set_socket_options(sock_opts);
+    r.acceptor->set_conn_limiter(r.shard_conn_limiter ?
+      r.shard_conn_limiter.get() : &conn_limiter, r.interrupter.get());
+
+    if (defer_accept)
+      r.acceptor->set_defer_accept(defer_accept);
+
+    // Make the rest of acceptors share a port chosen by system.
+    if (!addr.get_port())
+      addr = iqnet::Inet_addr(addr.get_host_name(), r.acceptor->get_addr().get_port());
+  }
+}
+
+void Server::Impl::run_reactor(Server_reactor* r)
+{
+  for(bool have_handlers = true; have_handlers;)
+  {
+    if (exit_flag)
+      break;
+
+    have_handlers = r->reactor->handle_events();
+  }
+}
+
+void Server::Impl::run_reactor_thread(
+  Server* server, Server_reactor* r, unsigned cpu)
+{
+  if (sharded)
+    pin_to_cpu(cpu);
+
+  try {
+    run_reactor(r);
+  }
+  catch (const std::exception& e)
+  {
+    boost::mutex::scoped_lock lk(error_lock);
+    if (error.empty())
+      error = e.what();
+  }
+  catch (...)
+  {
+    boost::mutex::scoped_lock lk(error_lock);
+    if (error.empty())
+      error = "unknown exception";
+  }
+
+  // One reactor is stopped, so stop the whole server.
+  server->set_exit_flag();
+}
+
 // ---------------------------------------------------------------------------
 Server::Server(
   const iqnet::Inet_addr& addr,
@@ -86,12 +318,24 @@ void Server::set_exit_flag()
 
 void Server::interrupt()
 {
-  impl->interrupter->make_interrupt();
+  typedef Impl::Reactors::iterator I;
+  for (I i = impl->reactors.begin(); i != impl->reactors.end(); ++i)
+    (*i)->interrupter->make_interrupt();
+}
+
+void Server::interrupt(iqnet::Reactor_base* reactor)
+{
+  Server_reactor* r = impl->find_reactor(reactor);
+
+  if (r)
+    r->interrupter->make_interrupt();
+  else
+    interrupt();
 }
 
 iqnet::Reactor_base* Server::get_reactor()
 {
-  return impl->reactor.get();
+  return impl->reactors.front()->reactor.get();
 }
 
 void Server::push_interceptor(Interceptor* ic)
@@ -135,21 +379,190 @@ http::Verification_level Server::get_verification_level() const
   return impl->ver_level;
 }
 
+void Server::set_idle_timeout( unsigned seconds )
+{
+  impl->idle_timeout = seconds;
+}
+
+unsigned Server::get_idle_timeout() const
+{
+  return impl->idle_timeout;
+}
+
+void Server::set_header_timeout( unsigned seconds )
+{
+  impl->header_timeout = seconds;
+}
+
+unsigned Server::get_header_timeout() const
+{
+  return impl->header_timeout;
+}
+
+void Server::set_body_timeout( unsigned seconds )
+{
+  impl->body_timeout = seconds;
+}
+
+unsigned Server::get_body_timeout() const
+{
+  return impl->body_timeout;
+}
+
+void Server::set_max_requests_per_conn( unsigned num )
+{
+  impl->max_requests_per_conn = num;
+}
+
+unsigned Server::get_max_requests_per_conn() const
+{
+  return impl->max_requests_per_conn;
+}
+
+void Server::set_max_pipelined_requests( unsigned num )
+{
+  impl->max_pipelined = num;
+}
+
+unsigned Server::get_max_pipelined_requests() const
+{
+  return impl->max_pipelined;
+}
+
+void Server::set_compression_threshold( size_t sz )
+{
+  impl->compression_threshold = sz;
+}
+
+size_t Server::get_compression_threshold() const
+{
+  return impl->compression_threshold;
+}
+
+void Server::set_response_chunk_sz( size_t sz )
+{
+  impl->response_chunk_sz = sz;
+}
+
+size_t Server::get_response_chunk_sz() const
+{
+  return impl->response_chunk_sz;
+}
+
 void Server::set_auth_plugin( const Auth_Plugin_base& ap )
 {
   impl->auth_plugin = &ap;
+
+  if (impl->auth_cache)
+    impl->auth_cache->clear();
+
+  typedef Impl::Reactors::iterator I;
+  for (I i = impl->reactors.begin(); i != impl->reactors.end(); ++i)
+  {
+    if ((*i)->shard_auth_cache)
+      (*i)->shard_auth_cache->clear();
+  }
+}
+
+void Server::set_auth_cache( size_t max_entries, unsigned ttl )
+{
+  impl->auth_cache.reset(max_entries ? new Auth_cache(max_entries, ttl) : 0);
+  impl->auth_cache_sz = max_entries;
+  impl->auth_cache_ttl = ttl;
+}
+
+void Server::set_num_reactors( unsigned num )
+{
+  impl->num_reactors = num ? num : 1;
+}
+
+void Server::set_listen_backlog( unsigned backlog )
+{
+  impl->backlog = backlog;
+}
+
+void Server::set_accept_budget( unsigned budget )
+{
+  impl->accept_budget = budget;
+}
+
+void Server::set_defer_accept( unsigned timeout )
+{
+  impl->defer_accept = timeout;
+}
+
+void Server::set_socket_options( const iqnet::Socket_options& opts )
+{
+  impl->sock_opts = opts;
+}
+
+void Server::set_max_connections( size_t max, size_t low_watermark )
+{
+  impl->conn_limiter.set_max_connections(max, low_watermark);
+  impl->max_conns = max;
+  impl->conns_low_watermark = low_watermark;
+}
+
+void Server::set_max_connections_per_ip( size_t max )
+{
+  impl->conn_limiter.set_max_connections_per_ip(max);
+  impl->max_conns_per_ip = max;
+}
+
+size_t Server::get_num_connections() const
+{
+  size_t num = impl->conn_limiter.count();
+
+  typedef Impl::Reactors::const_iterator I;
+  for (I i = impl->reactors.begin(); i != impl->reactors.end(); ++i)
+  {
+    if ((*i)->shard_conn_limiter)
+      num += (*i)->shard_conn_limiter->count();
+  }
+
+  return num;
+}
+
+Server_reactor* Server::find_reactor( iqnet::Reactor_base* reactor )
+{
+  return impl->find_reactor(reactor);
+}
+
+void Server::connection_closed( Server_connection* conn )
+{
+  Server_reactor* r = conn->get_server_reactor();
+
+  if (r && r->shard_conn_limiter)
+    r->shard_conn_limiter->release(conn->get_peer_addr());
+  else
+    impl->conn_limiter.release(conn->get_peer_addr());
+}
+
+void Server::set_num_shards( unsigned num )
+{
+  if (!dynamic_cast<Serial_executor_factory*>(impl->exec_factory))
+    throw Exception("Server: shards run serial executors only");
+
+  if (!num)
+    num = boost::thread::hardware_concurrency();
+
+  set_num_reactors(num);
+  impl->sharded = true;
 }
 
 void Server::log_err_msg( const std::string& msg )
 {
-  if( impl->log )
-    *impl->log << msg << std::endl;
+  if( !impl->log )
+    return;
+
+  boost::mutex::scoped_lock lk(impl->log_lock);
+  *impl->log << msg << std::endl;
 }
 
 namespace {
 
 boost::optional<std::string>
-authenticate(const http::Packet& pkt, const Auth_Plugin_base* ap)
+authenticate(const http::Packet& pkt, const Auth_Plugin_base* ap, Auth_cache* cache)
 {
   using namespace http;
 
@@ -168,27 +581,55 @@ authenticate(const http::Packet& pkt, const Auth_Plugin_base* ap)
   }
 
   std::string username, password;
+  std::string authinfo;
+
+  if (cache)
+  {
+    authinfo = hdr.raw_authinfo();
+    if (cache->find(authinfo, username))
+      return username;
+  }
+
   hdr.get_authinfo(username, password);
 
   if (!ap->authenticate(username, password))
     throw Unauthorized();
 
+  if (cache)
+    cache->insert(authinfo, username);
+
   return username;
 }
 
 } // anonymous namespace
 
+bool Server::parse_on_receive() const
+{
+  return !impl->auth_plugin;
+}
+
 void Server::schedule_execute( http::Packet* pkt, Server_connection* conn )
 {
   using boost::scoped_ptr;
   using boost::optional;
 
   Executor* executor = 0;
+  Executor_factory_base* exec_factory = impl->exec_factory;
+  Method_dispatcher_manager* disp_manager = &impl->disp_manager;
+  Auth_cache* auth_cache = impl->auth_cache.get();
+
+  Server_reactor* shard = conn->get_server_reactor();
+  if (shard && shard->shard_exec_factory.get())
+  {
+    exec_factory = shard->shard_exec_factory.get();
+    disp_manager = shard->shard_disp_manager.get();
+    auth_cache = shard->shard_auth_cache.get();
+  }
 
   try {
     scoped_ptr<http::Packet> packet(pkt);
-    optional<std::string> authname = authenticate(*pkt, impl->auth_plugin);
-    scoped_ptr<Request> req( parse_request(packet->content()) );
+    optional<std::string> authname = authenticate(*pkt, impl->auth_plugin, auth_cache);
+    scoped_ptr<Request> req( conn->get_request(*packet) );
 
     Method::Data mdata = {
       req->get_name(),
@@ -196,14 +637,14 @@ void Server::schedule_execute( http::Packet* pkt, Server_connection* conn )
       Server_feedback(this)
     };
 
-    Method* meth = impl->disp_manager.create_method( mdata );
+    Method* meth = disp_manager->create_method( mdata );
 
     if (authname)
       meth->authname(authname.get());
 
     pkt->header()->get_xheaders(meth->xheaders());
 
-    executor = impl->exec_factory->create( meth, this, conn );
+    executor = exec_factory->create( meth, this, conn );
     executor->set_interceptors(impl->interceptors.get());
     executor->execute( req->get_params() );
   }
@@ -238,9 +679,34 @@ void Server::schedule_response(
   const Response& resp, Server_connection* conn, Executor* exec )
 {
   std::auto_ptr<Executor> executor_to_delete(exec);
-  std::string resp_str = dump_response(resp);
-  http::Packet *packet = new http::Packet(new http::Response_header(), resp_str);
-  conn->schedule_response( packet );
+
+  unsigned seq = exec ? exec->request_seq() : conn->dispatched_request();
+  Server_connection::Response_format fmt = conn->response_format(seq);
+  std::auto_ptr<http::Packet> packet(new http::Packet(new http::Response_header()));
+
+  // Compression is applied to whole content.
+  if (impl->response_chunk_sz && fmt.chunked && fmt.coding == http::CODING_IDENTITY)
+  {
+    // In reactor's thread parts go to socket while response is built.
+    bool in_reactor = !exec || dynamic_cast<Serial_executor*>(exec);
+    if (in_reactor && conn->stream_response(resp, seq, impl->response_chunk_sz))
+      return;
+
+    std::vector<std::string> parts;
+    dump_response(resp, parts, impl->response_chunk_sz);
+    packet->swap_chunks(parts);
+  }
+  else
+  {
+    std::string resp_str = dump_response(resp);
+    packet->swap_content(resp_str);
+  }
+
+  // Response is compressed by executor, not by reactor.
+  if (packet->content().length() >= impl->compression_threshold)
+    packet->encode_content(fmt.coding);
+
+  conn->schedule_response( packet.release(), seq );
 }
 
 void Server::set_firewall( iqnet::Firewall_base* _firewall )
@@ -250,22 +716,38 @@ void Server::set_firewall( iqnet::Firewall_base* _firewall )
 
 void Server::work()
 {
-  if( !impl->acceptor.get() )
+  typedef Impl::Reactors::iterator I;
+  impl->start_acceptors(this);
+
+  if (impl->reactors.size() == 1 && !impl->sharded)
   {
-    impl->acceptor.reset(new iqnet::Acceptor( impl->bind_addr, get_conn_factory(), get_reactor()));
-    impl->acceptor->set_firewall( impl->firewall );
+    impl->run_reactor(impl->reactors.front());
   }
-
-  for(bool have_handlers = true; have_handlers;)
+  else
   {
-    if (impl->exit_flag)
-      break;
-
-    have_handlers = get_reactor()->handle_events();
+    boost::thread_group threads;
+    for (size_t i = 0; i < impl->reactors.size(); ++i)
+    {
+      threads.create_thread(boost::bind(
+        &Impl::run_reactor_thread, impl, this, impl->reactors[i], i));
+    }
+
+    threads.join_all();
   }
 
-  impl->acceptor.reset(0);
+  for (I i = impl->reactors.begin(); i != impl->reactors.end(); ++i)
+    (*i)->acceptor.reset(0);
+
   impl->exit_flag = false;
+
+  std::string error;
+  {
+    boost::mutex::scoped_lock lk(impl->error_lock);
+    error.swap(impl->error);
+  }
+
+  if (!error.empty())
+    throw iqnet::network_error("Server: " + error, false);
 }
 
 iqnet::Accepted_conn_factory* Server::get_conn_factory()
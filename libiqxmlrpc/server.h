@@ -23,6 +23,7 @@ namespace iqnet
 namespace iqxmlrpc {
 
 class Auth_Plugin_base;
+struct Server_reactor;
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -71,6 +72,121 @@ public:
   http::Verification_level get_verification_level() const;
 
   void set_auth_plugin(const Auth_Plugin_base&);
+
+  //! Cache successfully verified credentials for ttl seconds, so that
+  //! auth plugin is not called for every request. At most max_entries
+  //! credentials are kept, least recently used ones are evicted first.
+  //! Zero max_entries (default) turns the cache off. In shard mode
+  //! entries are split between shards like connection limits.
+  /*! Changed or revoked password is accepted until its entry expires. */
+  void set_auth_cache( size_t max_entries, unsigned ttl );
+
+  //! Close keep-alive connection which waits for the next request
+  //! longer than specified number of seconds. Zero (default) means no limit.
+  void set_idle_timeout( unsigned seconds );
+  unsigned get_idle_timeout() const;
+
+  //! Close connection which does not send complete request header
+  //! in specified number of seconds. Zero (default) means no limit.
+  void set_header_timeout( unsigned seconds );
+  unsigned get_header_timeout() const;
+
+  //! Close connection which does not send complete request body
+  //! in specified number of seconds after the header. Zero (default)
+  //! means no limit.
+  void set_body_timeout( unsigned seconds );
+  unsigned get_body_timeout() const;
+
+  //! Close connection after serving specified number of requests.
+  //! Zero (default) means no limit.
+  void set_max_requests_per_conn( unsigned );
+  unsigned get_max_requests_per_conn() const;
+
+  //! Set how many requests of one connection may be executed
+  //! at once (1 by default, zero is treated as 1).
+  /*! Pipelined requests beyond the limit are kept read but
+      not executed until earlier responses are queued. Responses
+      are always sent in order of requests. Values above 1 only
+      make sense with pool executor. */
+  void set_max_pipelined_requests( unsigned );
+  unsigned get_max_pipelined_requests() const;
+
+  //! Compress responses of at least specified size (in bytes)
+  //! with gzip or deflate if client accepts it. Zero (default)
+  //! disables compression. Compressed requests are accepted
+  //! regardless of this option, their decompressed size is
+  //! limited by set_max_request_sz(). Without that limit it
+  //! may not exceed 100 times the received size or 1 MB,
+  //! whichever is greater.
+  void set_compression_threshold( size_t );
+  size_t get_compression_threshold() const;
+
+  //! Build responses as parts of specified size and send responses
+  //! larger than one part with chunked transfer coding. Zero (default)
+  //! means responses are built in one buffer and sent with Content-Length.
+  /*! With Serial_executor over plain HTTP each part is sent as soon
+      as it is built, so sending starts before the response is complete.
+      Otherwise the whole response is still built before it is queued,
+      parts just avoid one large buffer and its copy.
+
+      Chunks are used only for HTTP/1.1 clients and responses which are
+      not compressed, otherwise the response is built in one buffer.
+      Chunked requests are accepted regardless of this option. */
+  void set_response_chunk_sz( size_t );
+  size_t get_response_chunk_sz() const;
+
+  //! Set size of listen queue (100 by default).
+  void set_listen_backlog( unsigned );
+
+  //! Set maximum number of connections accepted at once
+  //! before serving other events. Zero (default) means no limit.
+  void set_accept_budget( unsigned );
+
+  //! Accept connection only when client sends some data or timeout
+  //! in seconds expires (TCP_DEFER_ACCEPT). Zero (default) turns it off.
+  void set_defer_accept( unsigned timeout );
+
+  //! Set TCP options for accepted connections.
+  //! By default only TCP_NODELAY is turned on.
+  void set_socket_options( const iqnet::Socket_options& );
+
+  //! Limit number of simultaneous connections. Zero (default) means no limit.
+  /*! When limit is reached server stops accepting new connections
+      until their number drops below low watermark (90% of limit
+      when zero is given). Pending clients wait in listen queue. */
+  void set_max_connections( size_t max, size_t low_watermark = 0 );
+
+  //! Limit number of simultaneous connections from one IP address.
+  //! Extra connections are closed right after accepting.
+  void set_max_connections_per_ip( size_t );
+
+  //! Returns number of currently established connections.
+  size_t get_num_connections() const;
+
+  //! Set number of reactors which serve network I/O (1 by default).
+  /*! When more than one reactor is requested, work() runs each of them
+      in a separate thread with its own acceptor bound to the same address
+      with SO_REUSEPORT. All reactors share method dispatchers,
+      interceptors and executor factory, so firewall, interceptors and
+      methods must be thread-safe. Must be called before work().
+  */
+  void set_num_reactors(unsigned);
+
+  //! Switch server to shard-per-core mode with specified number of shards.
+  /*! Each shard is a reactor with its own acceptor (see set_num_reactors()),
+      serial executor and copy of method dispatchers. It runs in a thread
+      pinned to a separate CPU where available. Requests are processed
+      to completion by the thread which accepted connection, without
+      passing them to other threads. Zero means one shard per CPU.
+      Executor factory passed to constructor must be a serial one,
+      otherwise Exception is thrown.
+      Each shard has its own auth cache and connection limiter, which
+      gets its part of set_max_connections() limit and the whole per IP
+      limit. Interceptors, auth plugin, firewall and error log are
+      shared between shards, so they must be thread-safe.
+      Must be called before work().
+  */
+  void set_num_shards(unsigned = 0);
   /*! \} */
 
   //! \name Run/stop server
@@ -81,13 +197,26 @@ public:
   //! Ask server to exit from work() event handle loop.
   void set_exit_flag();
 
-  //! Interrupt poll cycle.
+  //! Interrupt poll cycle of all reactors.
   void interrupt();
+
+  //! Interrupt poll cycle of specific server's reactor.
+  void interrupt(iqnet::Reactor_base*);
   /*! \} */
 
+  //! Returns first (main) server's reactor.
   iqnet::Reactor_base* get_reactor();
 
+  //! Whether request content may be parsed as it is received.
+  //! It is not when auth plugin is set, so that nothing
+  //! is parsed before client is authenticated.
+  bool parse_on_receive() const;
+
+  //! Find server's reactor data by reactor it holds.
+  Server_reactor* find_reactor( iqnet::Reactor_base* );
+
   void schedule_execute( http::Packet*, Server_connection* );
+  void connection_closed( Server_connection* );
   void schedule_response( const Response&, Server_connection*, Executor* );
 
   void log_err_msg( const std::string& );
@@ -4,39 +4,86 @@
 #include "server_conn.h"
 #include "auth_plugin.h"
 #include "http_errors.h"
+#include "reactor.h"
+#include "request_parser.h"
+#include "response.h"
 #include "server.h"
+#include "util.h"
+
+#include <memory>
 
 using namespace iqxmlrpc;
 
 Server_connection::Server_connection( const iqnet::Inet_addr& a ):
   peer_addr(a),
   server(0),
-  keep_alive(false),
-  read_buf_(65536, '\0')
+  reactor(0),
+  server_reactor(0),
+  keep_alive(true),
+  read_phase(READ_NONE),
+  num_requests(0),
+  req_seq(0),
+  resp_seq(0),
+  dispatching(0),
+  executing(0),
+  orphaned(false)
 {
 }
 
 
 Server_connection::~Server_connection()
 {
+  util::delete_ptrs( ready.begin(), ready.end(),
+                     util::Select2nd<Responses>() );
+
+  if( server )
+    server->connection_closed( this );
 }
 
 
-http::Packet* Server_connection::read_request( const std::string& s )
+void Server_connection::set_reactor( iqnet::Reactor_base* r )
+{
+  reactor = r;
+  server_reactor = server ? server->find_reactor( r ) : 0;
+}
+
+
+http::Packet* Server_connection::read_request( const char* s, size_t len )
 {
   try
   {
     preader.set_verification_level( server->get_verification_level() );
     preader.set_max_size( server->get_max_request_sz() );
-    http::Packet* r = preader.read_request(s);
+    http::Packet* r = preader.read_request(s, len);
 
     if( r ) {
+      std::auto_ptr<http::Packet> p(r);
+
+      size_t max_sz = server->get_max_request_sz();
+      p->decode_content( max_sz ? max_sz : http::max_decoded_sz(p->content().length()) );
+
+      if( body_reader )
+        body_reader->feed( p->content() );
+
+      p.release();
+
       keep_alive = r->header()->conn_keep_alive();
-    } else if( preader.expect_continue() ) {
-      response = "HTTP/1.1 100\r\n\r\n";
-      keep_alive = true;
-      do_schedule_response();
-      preader.set_continue_sent();
+      num_requests++;
+
+      unsigned max_requests = server->get_max_requests_per_conn();
+      if( max_requests && num_requests >= max_requests )
+        keep_alive = false;
+    } else {
+      if( preader.header_read() && server->parse_on_receive() )
+        parse_content();
+
+      if( preader.expect_continue() && !requests_in_flight() ) {
+        std::string cont( "HTTP/1.1 100\r\n\r\n" );
+        response.append( cont );
+        keep_alive = true;
+        do_schedule_response();
+        preader.set_continue_sent();
+      }
     }
 
     return r;
@@ -48,12 +95,319 @@ http::Packet* Server_connection::read_request( const std::string& s )
 }
 
 
+void Server_connection::parse_content()
+{
+  std::string part;
+  if( !preader.take_content( part ) )
+    return;
+
+  if( !body_reader )
+    body_reader.reset( new Request_reader );
+
+  // Received data is released as soon as it is parsed.
+  body_reader->feed( part );
+}
+
+
+Request* Server_connection::get_request( const http::Packet& pkt )
+{
+  if( !body_reader )
+    return parse_request( pkt.content() );
+
+  boost::scoped_ptr<Request_reader> r;
+  r.swap( body_reader );
+  return r->get();
+}
+
+
+void Server_connection::update_read_phase( iqnet::Event_handler* h )
+{
+  if( requests_in_flight() || !keep_alive )
+    set_read_phase( h, READ_NONE );
+  else if( preader.header_read() )
+    set_read_phase( h, READ_BODY );
+  else if( preader.has_data() || !num_requests )
+    set_read_phase( h, READ_HEADER );
+  else
+    set_read_phase( h, READ_IDLE );
+}
+
+
+void Server_connection::set_read_phase( iqnet::Event_handler* h, Read_phase phase )
+{
+  // Timer limits the whole phase, so it is not restarted
+  // on each portion of data trickled by client.
+  if( phase == read_phase )
+    return;
+
+  read_phase = phase;
+  unsigned timeout = 0;
+
+  switch( phase )
+  {
+    case READ_IDLE:   timeout = server->get_idle_timeout(); break;
+    case READ_HEADER: timeout = server->get_header_timeout(); break;
+    case READ_BODY:   timeout = server->get_body_timeout(); break;
+    case READ_NONE:   break;
+  }
+
+  reactor->set_timer( h, timeout * 1000 );
+}
+
+
+unsigned Server_connection::new_request( const Response_format& fmt )
+{
+  boost::mutex::scoped_lock lk( resp_lock );
+  formats.push_back( fmt );
+  executing++;
+  return req_seq++;
+}
+
+
+void Server_connection::dispatch( http::Packet* pkt )
+{
+  const http::Request_header* h =
+    static_cast<const http::Request_header*>(pkt->header());
+
+  Response_format fmt;
+  fmt.chunked = h->version() == "HTTP/1.1";
+
+  if( server->get_compression_threshold() )
+    fmt.coding = http::choose_coding( h->accept_encoding() );
+
+  dispatching = new_request( fmt );
+  server->schedule_execute( pkt, this );
+
+  // Not taken when request is rejected before parsing.
+  body_reader.reset();
+}
+
+
+void Server_connection::respond_error( const http::Error_response& e )
+{
+  // Close connection after sending HTTP error response
+  keep_alive = false;
+  schedule_response( new http::Packet(e), new_request(Response_format()) );
+}
+
+
+Server_connection::Response_format
+Server_connection::response_format( unsigned seq )
+{
+  boost::mutex::scoped_lock lk( resp_lock );
+  return formats[seq - resp_seq];
+}
+
+
 void Server_connection::schedule_response( http::Packet* pkt )
 {
-  std::auto_ptr<http::Packet> p(pkt);
-  p->set_keep_alive( keep_alive );
-  response = p->dump();
-  do_schedule_response();
+  schedule_response( pkt, dispatching );
+}
+
+
+void Server_connection::schedule_response( http::Packet* pkt, unsigned seq )
+{
+  bool last = false;
+
+  {
+    boost::mutex::scoped_lock lk( resp_lock );
+    executing--;
+
+    // Response is posted under the lock, so that release() can not
+    // drop the connection in between.
+    if( !orphaned )
+    {
+      ready[seq] = pkt;
+      do_schedule_response();
+      return;
+    }
+
+    last = !executing;
+  }
+
+  // Connection has been dropped while request was executed.
+  delete pkt;
+
+  if( last )
+    delete this;
+}
+
+
+bool Server_connection::pipeline_full() const
+{
+  unsigned max_requests = server->get_max_pipelined_requests();
+  return !keep_alive || requests_in_flight() >= (max_requests ? max_requests : 1);
+}
+
+
+bool Server_connection::response_ready()
+{
+  boost::mutex::scoped_lock lk( resp_lock );
+  return !ready.empty() && ready.begin()->first == resp_seq;
+}
+
+
+bool Server_connection::flush_responses()
+{
+  boost::mutex::scoped_lock lk( resp_lock );
+  return flush_ready();
+}
+
+
+bool Server_connection::flush_ready()
+{
+  bool flushed = false;
+
+  for( Responses::iterator i = ready.begin();
+       i != ready.end() && i->first == resp_seq; ready.erase(i++) )
+  {
+    std::auto_ptr<http::Packet> p(i->second);
+    resp_seq++;
+    formats.pop_front();
+
+    // Streamed response is already in the output buffer.
+    if( !p.get() )
+      continue;
+
+    // Connection stays open while there are more requests to answer.
+    p->set_keep_alive( keep_alive || resp_seq != req_seq );
+
+    // Header and content (or chunks) are sent as separate segments.
+    p->dump_to( response );
+    flushed = true;
+  }
+
+  return flushed;
+}
+
+
+//! Passes parts of response to the connection's output buffer
+//! and sends them right away. Response of one part is sent
+//! with Content-Length as usual.
+class Server_connection::Stream_writer: public Response_writer {
+public:
+  Stream_writer( Server_connection& c, bool keep ):
+    conn(c), keep_alive(keep), started(false), broken(false) {}
+
+  void write_part( std::string& part )
+  {
+    if( !started && head.empty() )
+    {
+      head.swap( part );
+      return;
+    }
+
+    if( !started )
+    {
+      http::Response_header* h = new http::Response_header();
+      h->set_chunked( true );
+      http::Packet hdr( h );
+      hdr.set_keep_alive( keep_alive );
+      hdr.dump_to( conn.response );
+
+      started = true;
+      send_chunk( head, true );
+    }
+
+    send_chunk( part, false );
+  }
+
+  void finish()
+  {
+    if( started )
+    {
+      std::string last;
+      send_chunk( last, false );
+      return;
+    }
+
+    http::Packet p( new http::Response_header() );
+    p.swap_content( head );
+    p.set_keep_alive( keep_alive );
+    p.dump_to( conn.response );
+    send();
+  }
+
+  bool is_started() const { return started; }
+
+private:
+  void send_chunk( std::string& data, bool first )
+  {
+    http::Packet::dump_chunk_to( conn.response, data, first );
+    send();
+  }
+
+  void send()
+  {
+    // Rest of response is still put to output buffer,
+    // sending it fails in reactor and closes connection.
+    if( !broken )
+      broken = !conn.send_available();
+  }
+
+  Server_connection& conn;
+  bool keep_alive;
+  bool started;
+  bool broken;
+  std::string head;
+};
+
+
+bool Server_connection::stream_response(
+  const Response& resp, unsigned seq, size_t part_sz )
+{
+  if( !can_send_available() )
+    return false;
+
+  bool keep;
+  {
+    boost::mutex::scoped_lock lk( resp_lock );
+
+    // Earlier responses go to output buffer first.
+    flush_ready();
+
+    if( orphaned || seq != resp_seq )
+      return false;
+
+    keep = keep_alive || seq + 1 != req_seq;
+  }
+
+  Stream_writer out( *this, keep );
+
+  try {
+    dump_response( resp, out, part_sz );
+    out.finish();
+  }
+  catch( const std::exception& e )
+  {
+    // Nothing is sent yet, let caller handle it as before.
+    if( !out.is_started() )
+      throw;
+
+    // Header is sent already, so client can only see that
+    // response is incomplete when connection is closed.
+    server->log_err_msg( std::string("Server: ") + e.what() );
+    keep_alive = false;
+  }
+
+  // Response is in flight until output buffer is sent.
+  schedule_response( 0, seq );
+  return true;
+}
+
+
+bool Server_connection::release( iqnet::Event_handler* h )
+{
+  boost::mutex::scoped_lock lk( resp_lock );
+
+  // Response could be posted after reactor has dropped the handler.
+  reactor->unregister_handler( h );
+
+  if( !executing )
+    return true;
+
+  orphaned = true;
+  return false;
 }
 
 // vim:ts=2:sw=2:et
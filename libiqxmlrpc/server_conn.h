@@ -4,19 +4,28 @@
 #ifndef _iqxmlrpc_server_conn_h_
 #define _iqxmlrpc_server_conn_h_
 
-#include <vector>
+#include <deque>
+#include <map>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "buffer_chain.h"
 #include "connection.h"
 #include "conn_factory.h"
 #include "http.h"
 
 namespace iqnet
 {
+  class Event_handler;
   class Reactor_base;
 }
 
 namespace iqxmlrpc {
 
+class Request;
+class Request_reader;
+class Response;
 class Server;
+struct Server_reactor;
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -28,8 +37,12 @@ class LIBIQXMLRPC_API Server_connection {
 protected:
   iqnet::Inet_addr peer_addr;
   Server *server;
+  iqnet::Reactor_base* reactor;
+  Server_reactor* server_reactor;
   http::Packet_reader preader;
-  std::string response;
+  iqnet::Buffer_chain response;
+  //! Whether more requests are read, true until the client
+  //! or an error tells otherwise.
   bool keep_alive;
 
 public:
@@ -43,18 +56,143 @@ public:
     server = s;
   }
 
+  //! Set reactor which serves the connection.
+  //! Must be called after set_server().
+  void set_reactor( iqnet::Reactor_base* );
+
+  iqnet::Reactor_base* get_reactor() const { return reactor; }
+
+  //! Server's data of the reactor, found once the reactor is set.
+  Server_reactor* get_server_reactor() const { return server_reactor; }
+
+  //! Number of request which is being passed to server right now.
+  unsigned dispatched_request() const { return dispatching; }
+
+  //! Queue response to the request being passed to server right now.
   void schedule_response( http::Packet* );
 
+  //! Queue response to specified request. Responses are sent
+  //! in order of requests. May be called from any thread.
+  void schedule_response( http::Packet*, unsigned request );
+
+  //! Get request from packet being dispatched. Its content
+  //! may be already parsed as it was received.
+  Request* get_request( const http::Packet& );
+
+  //! What client accepts in response to request.
+  struct Response_format {
+    http::Content_coding coding;
+    bool chunked;
+
+    Response_format( http::Content_coding c = http::CODING_IDENTITY, bool ch = false ):
+      coding(c), chunked(ch) {}
+  };
+
+  //! Format of response to specified request which is not queued yet.
+  Response_format response_format( unsigned request );
+
+  //! Send response to specified request with chunked transfer coding
+  //! while it is being built, passing parts of specified size to socket
+  //! as they are ready. Must be called in reactor's thread.
+  /*! \return false if the response can not be sent right now: transport
+      does not support it or earlier responses are not ready yet.
+      Then it should be queued with schedule_response(). */
+  bool stream_response( const Response&, unsigned request, size_t part_sz );
+
 protected:
-  http::Packet* read_request( const std::string& );
+  //! What connection waits from client, defines read timeout.
+  enum Read_phase { READ_NONE, READ_IDLE, READ_HEADER, READ_BODY };
+
+  http::Packet* read_request( const char*, size_t );
+
+  //! Try to read pipelined request received along with previous one.
+  http::Packet* read_buffered_request()
+  {
+    return preader.has_pending() ? read_request( 0, 0 ) : 0;
+  }
+
+  //! Pass complete request to server for execution.
+  void dispatch( http::Packet* );
+
+  //! Queue error response and stop reading requests.
+  void respond_error( const http::Error_response& );
+
+  //! Number of read requests which responses are not queued
+  //! for sending yet.
+  unsigned requests_in_flight() const { return req_seq - resp_seq; }
+
+  //! Whether connection should not read more requests for now.
+  /*! It is so when the number of requests in flight reached limit
+      (see Server::set_max_pipelined_requests()) or connection
+      is going to be closed. */
+  bool pipeline_full() const;
 
-  char* read_buf() { return &read_buf_[0]; }
-  size_t read_buf_sz() const { return read_buf_.size(); }
+  //! Move responses which turn has come to the output buffer.
+  //! \return false if there were no such responses.
+  bool flush_responses();
 
+  //! Same as flush_responses() for do_schedule_response(),
+  //! which is called with responses lock held.
+  bool flush_ready();
+
+  //! Whether next response to send is ready.
+  bool response_ready();
+
+  //! Rearm handler's timer according to what connection waits for:
+  //! next request, rest of the current one or responses.
+  void update_read_phase( iqnet::Event_handler* );
+
+  //! Called when connection is dropped by reactor.
+  //! \return false if some requests are still being executed,
+  //! then connection deletes itself when they complete.
+  bool release( iqnet::Event_handler* );
+
+  //! Reading is done to reactor's buffer, the connection keeps
+  //! only unparsed part of request.
+  char* read_buf() { return reactor->read_buffer(); }
+  size_t read_buf_sz() const { return iqnet::Reactor_base::read_buffer_sz; }
+
+  //! Make reactor send queued responses. Called from executor
+  //! thread with responses lock held, or from reactor thread.
   virtual void do_schedule_response() = 0;
 
+  //! Whether output buffer can be sent by send_available().
+  virtual bool can_send_available() const { return false; }
+
+  //! Send as much of output buffer as socket takes without blocking.
+  //! \return false if connection is broken.
+  virtual bool send_available() { return false; }
+
 private:
-  std::vector<char> read_buf_;
+  class Stream_writer;
+  friend class Stream_writer;
+
+  void set_read_phase( iqnet::Event_handler*, Read_phase );
+
+  //! Parse content of incomplete request received so far.
+  void parse_content();
+
+  unsigned new_request( const Response_format& );
+
+  //! Null packet stands for streamed response, it is complete
+  //! when output buffer is sent.
+  typedef std::map<unsigned, http::Packet*> Responses;
+
+  Read_phase read_phase;
+  unsigned num_requests;
+  boost::scoped_ptr<Request_reader> body_reader;
+
+  unsigned req_seq;
+  unsigned resp_seq;
+  unsigned dispatching;
+
+  // Shared with executor threads.
+  boost::mutex resp_lock;
+  Responses ready;
+  // Formats of responses not flushed yet.
+  std::deque<Response_format> formats;
+  unsigned executing;
+  bool orphaned;
 };
 
 #ifdef _MSC_VER
@@ -73,16 +211,22 @@ public:
   Server_conn_factory():
     server(0), reactor(0) {}
 
+  void post_init( Server* s )
+  {
+    server = s;
+  }
+
+  //! Reactor is used for connections created without one.
   void post_init( Server* s, iqnet::Reactor_base* r )
   {
     server = s;
     reactor = r;
   }
 
-  void post_create( Transport* c )
+  void post_create( Transport* c, iqnet::Reactor_base* r )
   {
     c->set_server( server );
-    c->set_reactor( reactor );
+    c->set_reactor( r ? r : reactor );
   }
 };
 
@@ -3,7 +3,9 @@
 
 #include <errno.h>
 #include <boost/cerrno.hpp>
+#include "config.h"
 #include "socket.h"
+#include "buffer_chain.h"
 #include "net_except.h"
 
 #if _MSC_VER >= 1700
@@ -67,6 +69,68 @@ void Socket::set_non_blocking( bool flag )
 #endif //WIN32
 }
 
+void Socket::set_reuse_port( bool flag )
+{
+#if defined(SO_REUSEPORT)
+  int enable = flag ? 1 : 0;
+  if( setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable) ) == -1 )
+    throw network_error( "Socket::set_reuse_port" );
+#else
+  if( flag )
+    throw network_error( "Socket::set_reuse_port: SO_REUSEPORT is not supported", false );
+#endif
+}
+
+namespace {
+
+inline bool setsockopt_int( Socket::Handler sock, int level, int opt, int val )
+{
+  return setsockopt( sock, level, opt,
+    reinterpret_cast<const char*>(&val), sizeof(val) ) != -1;
+}
+
+} // anonymous namespace
+
+void Socket::set_options( const Socket_options& opts )
+{
+  if( !setsockopt_int( sock, IPPROTO_TCP, TCP_NODELAY, opts.nodelay ? 1 : 0 ) )
+    throw network_error( "Socket::set_options(TCP_NODELAY)" );
+
+#if defined(TCP_QUICKACK)
+  if( opts.quickack && !setsockopt_int( sock, IPPROTO_TCP, TCP_QUICKACK, 1 ) )
+    throw network_error( "Socket::set_options(TCP_QUICKACK)" );
+#endif
+
+  if( opts.send_buf_sz && !setsockopt_int( sock, SOL_SOCKET, SO_SNDBUF, opts.send_buf_sz ) )
+    throw network_error( "Socket::set_options(SO_SNDBUF)" );
+
+  if( opts.recv_buf_sz && !setsockopt_int( sock, SOL_SOCKET, SO_RCVBUF, opts.recv_buf_sz ) )
+    throw network_error( "Socket::set_options(SO_RCVBUF)" );
+
+  if( opts.keepalive_idle )
+  {
+    if( !setsockopt_int( sock, SOL_SOCKET, SO_KEEPALIVE, 1 ) )
+      throw network_error( "Socket::set_options(SO_KEEPALIVE)" );
+
+#if defined(TCP_KEEPIDLE)
+    if( !setsockopt_int( sock, IPPROTO_TCP, TCP_KEEPIDLE, opts.keepalive_idle ) )
+      throw network_error( "Socket::set_options(TCP_KEEPIDLE)" );
+#endif
+  }
+}
+
+void Socket::set_defer_accept( unsigned timeout )
+{
+#if defined(TCP_DEFER_ACCEPT)
+  int val = static_cast<int>(timeout);
+  if( setsockopt( sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, &val, sizeof(val) ) == -1 )
+    throw network_error( "Socket::set_defer_accept" );
+#else
+  if( timeout )
+    throw network_error( "Socket::set_defer_accept: TCP_DEFER_ACCEPT is not supported", false );
+#endif
+}
+
 #if defined(MSG_NOSIGNAL)
 #define IQXMLRPC_NOPIPE MSG_NOSIGNAL
 #else
@@ -83,6 +147,57 @@ size_t Socket::send( const char* data, size_t len )
   return static_cast<size_t>(ret);
 }
 
+namespace {
+
+//! \return -1 on error like the system call.
+long send_chain( Socket::Handler sock, const Buffer_chain& chain )
+{
+  if( chain.empty() )
+    return 0;
+
+#ifdef WIN32
+  return ::send( sock, chain.data(), static_cast<int>(chain.length()), IQXMLRPC_NOPIPE );
+#else
+  struct iovec iov[16];
+  struct msghdr msg;
+  memset( &msg, 0, sizeof(msg) );
+  msg.msg_iov = iov;
+  msg.msg_iovlen = chain.fill_iovec( iov, sizeof(iov)/sizeof(iov[0]) );
+
+  return ::sendmsg( sock, &msg, IQXMLRPC_NOPIPE );
+#endif
+}
+
+} // anonymous namespace
+
+size_t Socket::send( const Buffer_chain& chain )
+{
+  long ret = send_chain( sock, chain );
+
+  if( ret == -1 )
+    throw network_error( "Socket::send" );
+
+  return static_cast<size_t>(ret);
+}
+
+size_t Socket::send_nonblocking( const Buffer_chain& chain )
+{
+  long ret = send_chain( sock, chain );
+
+  if( ret != -1 )
+    return static_cast<size_t>(ret);
+
+#ifdef WIN32
+  if( get_last_error() == WSAEWOULDBLOCK )
+    return 0;
+#else
+  if( errno == EAGAIN || errno == EWOULDBLOCK )
+    return 0;
+#endif
+
+  throw network_error( "Socket::send" );
+}
+
 size_t Socket::recv( char* buf, size_t len )
 {
   int ret = ::recv( sock, buf, static_cast<int>(len), 0 );
@@ -127,6 +242,59 @@ Socket Socket::accept()
   return Socket( new_sock, Inet_addr(addr) );
 }
 
+boost::optional<Socket> Socket::accept_nonblocking()
+{
+  sockaddr_in addr;
+
+  for(;;)
+  {
+    socklen_t len = sizeof(sockaddr_in);
+#if defined(HAVE_ACCEPT4)
+    Handler new_sock = ::accept4( sock, reinterpret_cast<sockaddr*>(&addr), &len,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC );
+#else
+    Handler new_sock = ::accept( sock, reinterpret_cast<sockaddr*>(&addr), &len );
+#endif
+
+    if( new_sock != -1 )
+    {
+      Socket accepted( new_sock, Inet_addr(addr) );
+#if !defined(HAVE_ACCEPT4)
+      accepted.set_non_blocking( true );
+#if defined(FD_CLOEXEC)
+      fcntl( new_sock, F_SETFD, FD_CLOEXEC );
+#endif
+#endif
+      return accepted;
+    }
+
+#ifdef WIN32
+    if( get_last_error() == WSAEWOULDBLOCK )
+      return boost::optional<Socket>();
+
+    throw network_error( "Socket::accept" );
+#else
+    switch( errno )
+    {
+    case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+    case EWOULDBLOCK:
+#endif
+      return boost::optional<Socket>();
+
+    // Connection was reset while waiting in queue, try next one.
+    case ECONNABORTED:
+    case EPROTO:
+    case EINTR:
+      continue;
+
+    default:
+      throw network_error( "Socket::accept" );
+    }
+#endif //WIN32
+  }
+}
+
 bool Socket::connect( const iqnet::Inet_addr& peer_addr )
 {
   const sockaddr* saddr = reinterpret_cast<const sockaddr*>(peer_addr.get_sockaddr());
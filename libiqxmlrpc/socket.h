@@ -6,9 +6,39 @@
 
 #include "inet_addr.h"
 
+#include <boost/optional.hpp>
+
 namespace iqnet
 {
 
+class Buffer_chain;
+
+//! TCP tuning options applied to connected sockets.
+/*! Defaults are tuned for small request/response exchanges. */
+struct LIBIQXMLRPC_API Socket_options {
+  //! Disable Nagle's algorithm (TCP_NODELAY). On by default.
+  bool nodelay;
+  //! Send ACKs immediately (TCP_QUICKACK) where supported. Kernel clears
+  //! it by itself later, so it only affects beginning of a connection.
+  bool quickack;
+  //! Size of send buffer (SO_SNDBUF), zero keeps system default.
+  int send_buf_sz;
+  //! Size of receive buffer (SO_RCVBUF), zero keeps system default.
+  int recv_buf_sz;
+  //! Turns on SO_KEEPALIVE with specified idle time in seconds
+  //! (TCP_KEEPIDLE where supported). Zero keeps keep-alive off.
+  int keepalive_idle;
+
+  Socket_options():
+    nodelay(true),
+    quickack(false),
+    send_buf_sz(0),
+    recv_buf_sz(0),
+    keepalive_idle(0)
+  {
+  }
+};
+
 //! Relatively portable socket class.
 class LIBIQXMLRPC_API Socket {
 public:
@@ -38,8 +68,28 @@ public:
   //! \note Does not disable non-blocking mode under UNIX.
   void set_non_blocking( bool );
 
+  //! Allow several sockets to bind the same address (SO_REUSEPORT).
+  /*! Must be called before bind(). Throws network_error
+      when platform does not support the option. */
+  void set_reuse_port( bool );
+
+  //! Apply TCP tuning options. Options the platform does not support
+  //! are silently skipped, other failures throw network_error.
+  void set_options( const Socket_options& );
+
+  //! Do not report accepted connection until client sends data
+  //! or timeout in seconds expires (TCP_DEFER_ACCEPT). Zero turns it off.
+  /*! Throws network_error when platform does not support the option. */
+  void set_defer_accept( unsigned timeout );
+
   /*! \b Can \b not cause SIGPIPE signal. */
   virtual size_t send( const char*, size_t );
+  /*! Gather write of not sent part of the chain.
+      \b Can \b not cause SIGPIPE signal. */
+  size_t send( const Buffer_chain& );
+  //! Same as send(const Buffer_chain&) but returns 0 instead of
+  //! throwing when non-blocking socket can not take data right now.
+  size_t send_nonblocking( const Buffer_chain& );
   virtual void send_shutdown( const char*, size_t );
   /*! \b Can \b not cause SIGPIPE signal. */
   virtual size_t recv( char*, size_t );
@@ -47,6 +97,10 @@ public:
   void   bind( const Inet_addr& addr );
   void   listen( unsigned backlog = 5 );
   Socket accept();
+  //! Accept connection on non-blocking listening socket.
+  /*! Accepted socket is made non-blocking and close-on-exec.
+      \return empty value if there are no more pending connections. */
+  boost::optional<Socket> accept_nonblocking();
   bool   connect( const iqnet::Inet_addr& );
 
   //! Returns an inet addr the socket asscociated with.
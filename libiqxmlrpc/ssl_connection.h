@@ -84,6 +84,9 @@ protected:
   void reg_send( const char*, size_t );
   void reg_recv( char*, size_t );
 
+  //! Whether receiving is registered (see reg_recv()).
+  bool reading() const { return state == READING; }
+
   //! Overwrite it for server connection.
   virtual void accept_succeed()  {};
   //! Overwrite it for client connection.
@@ -12,6 +12,7 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+#include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/once.hpp>
 
@@ -259,9 +260,20 @@ Ctx::prepare_verify(SSL* ssl, bool server)
 }
 
 // ----------------------------------------------------------------------------
+namespace {
+
+//! OpenSSL has no reason string for empty error queue.
+std::string error_reason( unsigned long err )
+{
+  const char* reason = ERR_reason_error_string( err );
+  return reason ? reason : "unknown error";
+}
+
+} // anonymous namespace
+
 exception::exception() throw():
   ssl_err( ERR_get_error() ),
-  msg( ERR_reason_error_string(ssl_err) )
+  msg( error_reason(ssl_err) )
 {
   msg.insert(0, "SSL: ");
 }
@@ -269,7 +281,7 @@ exception::exception() throw():
 
 exception::exception( unsigned long err ) throw():
   ssl_err(err),
-  msg( ERR_reason_error_string(ssl_err) )
+  msg( error_reason(ssl_err) )
 {
   msg.insert(0, "SSL: ");
 }
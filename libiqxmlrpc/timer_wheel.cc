@@ -0,0 +1,280 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "timer_wheel.h"
+
+#ifndef _WINDOWS
+#include <time.h>
+#endif
+
+using namespace iqnet;
+
+namespace {
+
+//! Timer resolution in milliseconds.
+const Timer_wheel::Msec tick_ms = 50;
+
+inline int first_bit(boost::uint64_t w)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(w);
+#else
+  int i = 0;
+  for (; !(w & 1); w >>= 1)
+    ++i;
+  return i;
+#endif
+}
+
+//! Mask of bits from lo to hi inclusive.
+inline boost::uint64_t bit_range(int lo, int hi)
+{
+  return (~boost::uint64_t(0) >> (63 - hi)) & (~boost::uint64_t(0) << lo);
+}
+
+} // anonymous namespace
+
+Timer_wheel::Timer_wheel():
+  buckets(overflow + 1, -1),
+  num_timers(0),
+  last_tick(0)
+{
+  for (int i = 0; i < num_levels; ++i)
+    used[i] = 0;
+}
+
+Timer_wheel::Msec Timer_wheel::now()
+{
+#ifdef _WINDOWS
+  return static_cast<Msec>(GetTickCount64());
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<Msec>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+// Timers are placed relative to the first tick not processed yet:
+// to level 0 if they are in its block, to level 1 if they are in its
+// block of blocks and so on.
+int Timer_wheel::bucket_of(Msec tick) const
+{
+  Msec base = last_tick + 1;
+
+  for (int level = 0; level < num_levels; ++level)
+  {
+    int shift = slot_bits * level;
+
+    if ((tick >> (shift + slot_bits)) == (base >> (shift + slot_bits)))
+      return level * level_slots + static_cast<int>((tick >> shift) & (level_slots - 1));
+  }
+
+  return overflow;
+}
+
+void Timer_wheel::link(int fd)
+{
+  Timer& t = timers[fd];
+  t.bucket = bucket_of(t.tick);
+  int& head = buckets[t.bucket];
+
+  t.prev = -1;
+  t.next = head;
+
+  if (head != -1)
+    timers[head].prev = fd;
+
+  head = fd;
+
+  if (t.bucket != overflow)
+    used[t.bucket / level_slots] |= boost::uint64_t(1) << (t.bucket % level_slots);
+}
+
+void Timer_wheel::unlink(int fd)
+{
+  Timer& t = timers[fd];
+
+  if (t.prev != -1)
+    timers[t.prev].next = t.next;
+  else
+    buckets[t.bucket] = t.next;
+
+  if (t.next != -1)
+    timers[t.next].prev = t.prev;
+
+  if (buckets[t.bucket] == -1 && t.bucket != overflow)
+    used[t.bucket / level_slots] &= ~(boost::uint64_t(1) << (t.bucket % level_slots));
+
+  t = Timer();
+}
+
+void Timer_wheel::relink(int bucket)
+{
+  int fd = buckets[bucket];
+  buckets[bucket] = -1;
+
+  if (bucket != overflow)
+    used[bucket / level_slots] &= ~(boost::uint64_t(1) << (bucket % level_slots));
+
+  while (fd != -1)
+  {
+    int next = timers[fd].next;
+    link(fd);
+    fd = next;
+  }
+}
+
+// Move timers of blocks which begin at the first not processed tick
+// down, higher levels first as their timers may land to lower slots
+// which begin there as well.
+void Timer_wheel::cascade()
+{
+  Msec base = last_tick + 1;
+
+  if (!(base & ((Msec(1) << (slot_bits * num_levels)) - 1)))
+    relink(overflow);
+
+  for (int level = num_levels - 1; level > 0; --level)
+  {
+    int shift = slot_bits * level;
+
+    if (!(base & ((Msec(1) << shift) - 1)))
+      relink(level * level_slots + static_cast<int>((base >> shift) & (level_slots - 1)));
+  }
+}
+
+void Timer_wheel::set(Event_handler* h, unsigned ms)
+{
+  int fd = static_cast<int>(h->get_handler());
+  cancel(fd);
+
+  if (!ms)
+    return;
+
+  if (static_cast<size_t>(fd) >= timers.size())
+    timers.resize(fd + 1);
+
+  Msec t = now();
+  if (!num_timers)
+    last_tick = t / tick_ms;
+
+  Msec tick = (t + ms + tick_ms - 1) / tick_ms;
+  timers[fd].handler = h;
+  timers[fd].tick = tick > last_tick ? tick : last_tick + 1;
+  link(fd);
+  num_timers++;
+}
+
+void Timer_wheel::cancel(Socket::Handler fd)
+{
+  size_t i = static_cast<size_t>(fd);
+
+  if (i < timers.size() && timers[i].handler)
+  {
+    unlink(static_cast<int>(fd));
+    num_timers--;
+  }
+}
+
+Timer_wheel::Msec Timer_wheel::first_tick(int bucket) const
+{
+  int fd = buckets[bucket];
+  Msec tick = timers[fd].tick;
+
+  for (fd = timers[fd].next; fd != -1; fd = timers[fd].next)
+    if (timers[fd].tick < tick)
+      tick = timers[fd].tick;
+
+  return tick;
+}
+
+// Slots of a level before the one of the first not processed tick
+// are empty, and that one is already moved to lower levels.
+Timer_wheel::Msec Timer_wheel::next_tick() const
+{
+  if (used[0])
+    return ((last_tick + 1) & ~Msec(level_slots - 1)) | first_bit(used[0]);
+
+  for (int level = 1; level < num_levels; ++level)
+    if (used[level])
+      return first_tick(level * level_slots + first_bit(used[level]));
+
+  return first_tick(overflow);
+}
+
+// First tick of the nearest block to be moved down.
+Timer_wheel::Msec Timer_wheel::next_block() const
+{
+  Msec base = last_tick + 1;
+
+  for (int level = 1; level < num_levels; ++level)
+  {
+    if (!used[level])
+      continue;
+
+    int shift = slot_bits * level;
+    Msec parent = (base >> (shift + slot_bits)) << (shift + slot_bits);
+    return parent | (Msec(first_bit(used[level])) << shift);
+  }
+
+  int shift = slot_bits * num_levels;
+  return ((base >> shift) + 1) << shift;
+}
+
+Reactor_base::Timeout Timer_wheel::next_timeout() const
+{
+  if (!num_timers)
+    return -1;
+
+  Msec wait = next_tick() * tick_ms - now();
+  return wait > 0 ? static_cast<Reactor_base::Timeout>(wait) : 0;
+}
+
+void Timer_wheel::expire(Expired_list& out)
+{
+  Msec now_tick = now() / tick_ms;
+
+  while (num_timers && last_tick < now_tick)
+  {
+    Msec base = last_tick + 1;
+    Msec end;
+
+    if (used[0])
+    {
+      end = base | (level_slots - 1);
+      if (end > now_tick)
+        end = now_tick;
+
+      boost::uint64_t due = used[0] &
+        bit_range(static_cast<int>(base & (level_slots - 1)),
+                  static_cast<int>(end & (level_slots - 1)));
+
+      for (; due; due &= due - 1)
+      {
+        for (int fd = buckets[first_bit(due)]; fd != -1;)
+        {
+          int next = timers[fd].next;
+          out.push_back(Expired(fd, timers[fd].handler));
+          unlink(fd);
+          num_timers--;
+          fd = next;
+        }
+      }
+    }
+    else
+    {
+      // Nothing expires until the nearest block is moved down.
+      end = next_block() - 1;
+      if (end > now_tick)
+        end = now_tick;
+    }
+
+    last_tick = end;
+
+    if (!((last_tick + 1) & (level_slots - 1)))
+      cascade();
+  }
+
+  if (last_tick < now_tick)
+    last_tick = now_tick;
+}
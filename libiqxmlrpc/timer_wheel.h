@@ -0,0 +1,100 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_timer_wheel_h_
+#define _iqxmlrpc_timer_wheel_h_
+
+#include "reactor.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include <vector>
+
+namespace iqnet
+{
+
+//! Hierarchical timing wheel which keeps at most one timer per socket handler.
+/*! Level 0 has a slot per tick of the current block of 64 ticks, every
+    next level has a slot per block of the previous one. Timers are kept
+    in intrusive lists of slots, so both arming and cancelling cost O(1),
+    timers of a higher level slot are moved down when its block begins.
+    Non-empty slots are marked in a bit mask per level, so neither the
+    nearest deadline nor expired timers are searched by walking the wheel.
+    The class is not thread safe, Reactor protects it with its own lock.
+*/
+class LIBIQXMLRPC_API Timer_wheel: boost::noncopyable {
+public:
+  typedef boost::int64_t Msec;
+
+  struct Expired {
+    Socket::Handler fd;
+    Event_handler*  handler;
+
+    Expired(Socket::Handler f, Event_handler* h):
+      fd(f), handler(h) {}
+  };
+
+  typedef std::vector<Expired> Expired_list;
+
+  Timer_wheel();
+
+  //! Monotonic clock in milliseconds.
+  static Msec now();
+
+  //! Arm timer of handler's socket, replacing previous one if any.
+  //! Zero timeout cancels the timer.
+  void set(Event_handler*, unsigned ms);
+
+  void cancel(Socket::Handler);
+
+  bool empty() const { return !num_timers; }
+
+  //! Milliseconds until the nearest timer expires, or -1.
+  /*! Costs O(1) if the nearest timer is due in the current block,
+      otherwise timers of the nearest non-empty slot are compared. */
+  Reactor_base::Timeout next_timeout() const;
+
+  //! Remove expired timers and append them to the list.
+  void expire(Expired_list&);
+
+private:
+  enum {
+    slot_bits   = 6,
+    level_slots = 1 << slot_bits,
+    //! 64^5 ticks cover about 621 days, later timers wait in overflow list.
+    num_levels  = 5,
+    overflow    = num_levels * level_slots
+  };
+
+  struct Timer {
+    Event_handler* handler;
+    Msec tick;
+    int  bucket;
+    int  prev;
+    int  next;
+
+    Timer():
+      handler(0), tick(0), bucket(-1), prev(-1), next(-1) {}
+  };
+
+  int bucket_of(Msec tick) const;
+  void link(int fd);
+  void unlink(int fd);
+  void relink(int bucket);
+  void cascade();
+
+  Msec first_tick(int bucket) const;
+  Msec next_tick() const;
+  Msec next_block() const;
+
+  std::vector<Timer> timers;
+  std::vector<int> buckets;
+  boost::uint64_t used[num_levels];
+  size_t num_timers;
+  Msec last_tick;
+};
+
+} // namespace iqnet
+
+#endif
@@ -1,13 +1,129 @@
 //  Libiqxmlrpc - an object-oriented XML-RPC solution.
 //  Copyright (C) 2011 Anton Dedov
 
-#include <stdexcept>
-#include <boost/lexical_cast.hpp>
+#include "config.h"
 #include "except.h"
 #include "value_parser.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdexcept>
+
+#ifdef HAVE_XLOCALE_H
+#include <xlocale.h>
+#endif
+
 namespace iqxmlrpc {
 
+namespace {
+
+//! Parse optionally signed decimal integer.
+//! \return false if text is not a number or it does not fit int.
+bool
+parse_int(const std::string& s, int& result)
+{
+  const char* p = s.data();
+  const char* end = p + s.length();
+  bool negative = p != end && *p == '-';
+
+  if (p != end && (*p == '-' || *p == '+'))
+    ++p;
+
+  if (p == end)
+    return false;
+
+  const unsigned limit = negative ? 0u + INT_MAX + 1 : INT_MAX;
+  unsigned v = 0;
+
+  for (; p != end; ++p) {
+    if (*p < '0' || *p > '9')
+      return false;
+
+    unsigned d = *p - '0';
+    if (v > (limit - d) / 10)
+      return false;
+
+    v = v * 10 + d;
+  }
+
+  if (!negative)
+    result = static_cast<int>(v);
+  else
+    result = v ? -static_cast<int>(v - 1) - 1 : 0;
+
+  return true;
+}
+
+#if defined(HAVE_STRTOD_L)
+//! Numbers are parsed in C locale regardless of the global one.
+class C_locale {
+public:
+  C_locale(): loc(newlocale(LC_NUMERIC_MASK, "C", (locale_t)0)) {}
+  ~C_locale() { freelocale(loc); }
+
+  locale_t loc;
+};
+
+const C_locale c_locale;
+
+double
+c_strtod(const char* s, char** end)
+{
+  return strtod_l(s, end, c_locale.loc);
+}
+#elif defined(_MSC_VER)
+class C_locale {
+public:
+  C_locale(): loc(_create_locale(LC_NUMERIC, "C")) {}
+  ~C_locale() { _free_locale(loc); }
+
+  _locale_t loc;
+};
+
+const C_locale c_locale;
+
+double
+c_strtod(const char* s, char** end)
+{
+  return _strtod_l(s, end, c_locale.loc);
+}
+#else
+// Decimal point depends on global locale here.
+double
+c_strtod(const char* s, char** end)
+{
+  return strtod(s, end);
+}
+#endif
+
+//! Parse floating point number, strtod() gives correctly rounded result.
+//! \return false if text is not a number or it is out of range.
+bool
+parse_double(const std::string& s, double& result)
+{
+  // strtod() would skip leading blanks and accept hexadecimal numbers.
+  if (s.empty() || isspace(static_cast<unsigned char>(s[0])) ||
+      s.find_first_of("xX") != std::string::npos)
+    return false;
+
+  const char* begin = s.c_str();
+  char* end = 0;
+  errno = 0;
+  result = c_strtod(begin, &end);
+
+  if (end != begin + s.length())
+    return false;
+
+  // Too small number is rounded to zero or denormal, which is fine.
+  return errno != ERANGE || (result != HUGE_VAL && result != -HUGE_VAL);
+}
+
+} // anonymous namespace
+
 ValueBuilderBase::ValueBuilderBase(Parser& parser, bool expect_text):
   BuilderBase(parser, expect_text)
 {
@@ -23,10 +139,10 @@ public:
     value_(0)
   {
     static const StateMachine::StateTransition trans[] = {
-      { NONE, MEMBER, "member" },
-      { MEMBER, NAME_READ, "name" },
-      { NAME_READ, VALUE_READ, "value" },
-      { 0, 0, 0 }
+      { NONE, MEMBER, TAG_MEMBER },
+      { MEMBER, NAME_READ, TAG_NAME },
+      { NAME_READ, VALUE_READ, TAG_VALUE },
+      { 0, 0, TAG_UNKNOWN }
     };
     state_.set_transitions(trans);
     retval.reset(proxy_ = new Struct());
@@ -41,16 +157,15 @@ private:
   };
 
   virtual void
-  do_visit_element(const std::string& tagname)
+  do_visit_element(XmlRpcTag tag)
   {
-    switch (state_.change(tagname)) {
+    switch (state_.change(tag)) {
     case NAME_READ:
-      name_ = parser_.get_data();
+      want_data();
       break;
 
     case VALUE_READ:
-      value_ = sub_build<Value_type*, ValueBuilder>();
-      value_ = value_ ? value_ : new String("");
+      sub_build<ValueBuilder>();
       break;
 
     case MEMBER:
@@ -62,9 +177,22 @@ private:
   }
 
   virtual void
-  do_visit_element_end(const std::string& tagname)
+  do_visit_data(const std::string& data)
+  {
+    name_ = data;
+  }
+
+  virtual void
+  do_visit_sub_build(BuilderBase& b)
   {
-    if (tagname == "member") {
+    value_ = static_cast<ValueBuilder&>(b).result();
+    value_ = value_ ? value_ : new String("");
+  }
+
+  virtual void
+  do_visit_element_end(XmlRpcTag tag)
+  {
+    if (tag == TAG_MEMBER) {
       if (state_.get_state() != VALUE_READ) {
         throw XML_RPC_violation(parser_.context());
       }
@@ -89,10 +217,10 @@ public:
     proxy_(0)
   {
     static const StateMachine::StateTransition trans[] = {
-      { NONE, DATA, "data" },
-      { DATA, VALUES, "value" },
-      { VALUES, VALUES, "value" },
-      { 0, 0, 0 }
+      { NONE, DATA, TAG_DATA },
+      { DATA, VALUES, TAG_VALUE },
+      { VALUES, VALUES, TAG_VALUE },
+      { 0, 0, TAG_UNKNOWN }
     };
     state_.set_transitions(trans);
     retval.reset(proxy_ = new Array());
@@ -106,14 +234,19 @@ private:
   };
 
   virtual void
-  do_visit_element(const std::string& tagname)
+  do_visit_element(XmlRpcTag tag)
   {
-    if (state_.change(tagname) == VALUES) {
-      Value_type* tmp = sub_build<Value_type*, ValueBuilder>();
-      tmp = tmp ? tmp : new String("");
-      Value_ptr v(new Value(tmp));
-      proxy_->push_back(v);
-    }
+    if (state_.change(tag) == VALUES)
+      sub_build<ValueBuilder>();
+  }
+
+  virtual void
+  do_visit_sub_build(BuilderBase& b)
+  {
+    Value_type* tmp = static_cast<ValueBuilder&>(b).result();
+    tmp = tmp ? tmp : new String("");
+    Value_ptr v(new Value(tmp));
+    proxy_->push_back(v);
   }
 
   StateMachine state_;
@@ -140,31 +273,31 @@ ValueBuilder::ValueBuilder(Parser& parser):
   state_(parser, VALUE)
 {
   static const StateMachine::StateTransition trans[] = {
-    { VALUE,  STRING, "string" },
-    { VALUE,  INT,    "int" },
-    { VALUE,  INT,    "i4" },
-    { VALUE,  BOOL,   "boolean" },
-    { VALUE,  DOUBLE, "double" },
-    { VALUE,  BINARY, "base64" },
-    { VALUE,  TIME,   "dateTime.iso8601" },
-    { VALUE,  STRUCT, "struct" },
-    { VALUE,  ARRAY,  "array" },
-    { VALUE,  NIL,    "nil" },
-    { 0, 0, 0 }
+    { VALUE,  STRING, TAG_STRING },
+    { VALUE,  INT,    TAG_INT },
+    { VALUE,  INT,    TAG_I4 },
+    { VALUE,  BOOL,   TAG_BOOLEAN },
+    { VALUE,  DOUBLE, TAG_DOUBLE },
+    { VALUE,  BINARY, TAG_BASE64 },
+    { VALUE,  TIME,   TAG_DATETIME },
+    { VALUE,  STRUCT, TAG_STRUCT },
+    { VALUE,  ARRAY,  TAG_ARRAY },
+    { VALUE,  NIL,    TAG_NIL },
+    { 0, 0, TAG_UNKNOWN }
   };
   state_.set_transitions(trans);
 }
 
 void
-ValueBuilder::do_visit_element(const std::string& tagname)
+ValueBuilder::do_visit_element(XmlRpcTag tag)
 {
-  switch (state_.change(tagname)) {
+  switch (state_.change(tag)) {
   case STRUCT:
-    retval.reset(sub_build<Value_type*, StructBuilder>(true));
+    sub_build<StructBuilder>(true);
     break;
 
   case ARRAY:
-    retval.reset(sub_build<Value_type*, ArrayBuilder>(true));
+    sub_build<ArrayBuilder>(true);
     break;
 
   case NIL:
@@ -181,7 +314,14 @@ ValueBuilder::do_visit_element(const std::string& tagname)
 }
 
 void
-ValueBuilder::do_visit_element_end(const std::string&)
+ValueBuilder::do_visit_sub_build(BuilderBase& b)
+{
+  retval.reset(static_cast<ValueBuilderBase&>(b).result());
+  want_exit();
+}
+
+void
+ValueBuilder::do_visit_element_end(XmlRpcTag)
 {
   if (retval.get())
     return;
@@ -213,7 +353,8 @@ ValueBuilder::do_visit_element_end(const std::string&)
 void
 ValueBuilder::do_visit_text(const std::string& text)
 {
-  using boost::lexical_cast;
+  int i = 0;
+  double d = 0;
 
   switch (state_.get_state()) {
   case VALUE:
@@ -223,15 +364,24 @@ ValueBuilder::do_visit_text(const std::string& text)
     break;
 
   case INT:
-    retval.reset(new Int(lexical_cast<int>(text)));
+    if (!parse_int(text, i))
+      throw XML_RPC_violation("bad integer at " + parser_.context());
+
+    retval.reset(new Int(i));
     break;
 
   case BOOL:
-    retval.reset(new Bool(lexical_cast<int>(text) != 0));
+    if (!parse_int(text, i))
+      throw XML_RPC_violation("bad boolean at " + parser_.context());
+
+    retval.reset(new Bool(i != 0));
     break;
 
   case DOUBLE:
-    retval.reset(new Double(lexical_cast<double>(text)));
+    if (!parse_double(text, d))
+      throw XML_RPC_violation("bad double at " + parser_.context());
+
+    retval.reset(new Double(d));
     break;
 
   case BINARY:
@@ -29,10 +29,13 @@ public:
 
 private:
   virtual void
-  do_visit_element(const std::string&);
+  do_visit_element(XmlRpcTag);
 
   virtual void
-  do_visit_element_end(const std::string&);
+  do_visit_element_end(XmlRpcTag);
+
+  virtual void
+  do_visit_sub_build(BuilderBase&);
 
   virtual void
   do_visit_text(const std::string&);
@@ -3,6 +3,7 @@
 
 #include <stdexcept>
 #include "except.h"
+#include "response.h"
 #include "xml_builder.h"
 
 namespace iqxmlrpc {
@@ -47,17 +48,57 @@ XmlBuilder::Node::set_textdata(const std::string& data)
 // XmlBuilder
 //
 
-XmlBuilder::XmlBuilder()
+XmlBuilder::XmlBuilder():
+  out(0),
+  part_sz(0)
 {
   buf = xmlBufferCreate();
   throwBuildError(writer = xmlNewTextWriterMemory(buf, 0), (xmlTextWriter*)0);
   throwBuildError(xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL), -1);
 }
 
+XmlBuilder::XmlBuilder(Response_writer& w, size_t sz):
+  buf(0),
+  out(&w),
+  part_sz(sz)
+{
+  xmlOutputBufferPtr obuf = xmlOutputBufferCreateIO(write_part, 0, this, 0);
+  throwBuildError(obuf, (xmlOutputBufferPtr)0);
+  throwBuildError(writer = xmlNewTextWriter(obuf), (xmlTextWriter*)0);
+  throwBuildError(xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL), -1);
+}
+
 XmlBuilder::~XmlBuilder()
 {
+  // Rest of unfinished document is not passed on.
+  out = 0;
   xmlFreeTextWriter(writer);
-  xmlBufferFree(buf);
+
+  if (buf)
+    xmlBufferFree(buf);
+}
+
+int
+XmlBuilder::write_part(void* ctx, const char* data, int len)
+{
+  XmlBuilder* self = static_cast<XmlBuilder*>(ctx);
+  std::string& p = self->part;
+
+  // Flush of empty buffer must not start a new part.
+  if (!len || !self->out)
+    return len;
+
+  if (p.empty())
+    p.reserve(self->part_sz + len);
+
+  p.append(data, len);
+
+  if (p.length() >= self->part_sz) {
+    self->out->write_part(p);
+    p.erase();
+  }
+
+  return len;
 }
 
 void
@@ -71,6 +112,16 @@ void
 XmlBuilder::stop()
 {
   throwBuildError(xmlTextWriterEndDocument(writer), -1);
+
+  if (!out)
+    return;
+
+  xmlTextWriterFlush(writer);
+
+  if (!part.empty()) {
+    out->write_part(part);
+    part.erase();
+  }
 }
 
 std::string
@@ -8,10 +8,13 @@
 
 #include <boost/utility.hpp>
 #include <string>
+#include <vector>
 #include <libxml/xmlwriter.h>
 
 namespace iqxmlrpc {
 
+class Response_writer;
+
 class XmlBuilder: boost::noncopyable {
 public:
   class Node {
@@ -27,6 +30,12 @@ public:
   };
 
   XmlBuilder();
+
+  //! Build document into sequence of parts of about specified size
+  //! instead of single buffer. Every part is passed to the writer
+  //! as soon as it is complete, the last one by stop().
+  XmlBuilder(Response_writer& out, size_t part_sz);
+
   ~XmlBuilder();
 
   void
@@ -39,8 +48,13 @@ public:
   content() const;
 
 private:
+  static int write_part(void* ctx, const char* data, int len);
+
   xmlBufferPtr buf;
   xmlTextWriterPtr writer;
+  Response_writer* out;
+  std::string part;
+  size_t part_sz;
 };
 
 } // namespace iqxmlrpc
@@ -0,0 +1,798 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "xml_tokenizer.h"
+#include "except.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace iqxmlrpc {
+
+namespace {
+
+const char bom[] = "\xEF\xBB\xBF";
+const size_t bom_len = 3;
+
+inline bool
+is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool
+starts_with(const char* p, const char* end, const char* s, size_t len)
+{
+  return static_cast<size_t>(end - p) >= len && !memcmp(p, s, len);
+}
+
+//! Whether data is shorter than string and starts it.
+inline bool
+is_prefix(const char* p, const char* end, const char* s, size_t len)
+{
+  return static_cast<size_t>(end - p) < len && !memcmp(p, s, end - p);
+}
+
+const char*
+find(const char* p, const char* end, const char* s, size_t len)
+{
+  while (static_cast<size_t>(end - p) >= len) {
+    p = static_cast<const char*>(memchr(p, *s, end - p - len + 1));
+    if (!p)
+      return 0;
+
+    if (!memcmp(p, s, len))
+      return p;
+
+    ++p;
+  }
+
+  return 0;
+}
+
+inline bool
+equal(const Xml_tokenizer::Slice& a, const Xml_tokenizer::Slice& b)
+{
+  return a.len == b.len && !memcmp(a.data, b.data, a.len);
+}
+
+inline std::string
+to_string(const Xml_tokenizer::Slice& s)
+{
+  return std::string(s.data, s.len);
+}
+
+bool
+equal_nocase(const char* p, size_t len, const char* s)
+{
+  size_t i = 0;
+  for (; i < len && s[i]; ++i) {
+    char c = p[i] >= 'A' && p[i] <= 'Z' ? p[i] - 'A' + 'a' : p[i];
+    if (c != s[i])
+      return false;
+  }
+
+  return i == len && !s[i];
+}
+
+inline bool
+is_name_start(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+    c == '_' || c == ':' || (c & 0x80);
+}
+
+inline bool
+is_name_char(char c)
+{
+  return is_name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+//! Read pseudo-attribute of XML declaration.
+bool
+read_decl_attr(const char*& p, const char* end, const char*& name, size_t& name_len,
+  const char*& val, size_t& val_len)
+{
+  name = p;
+  while (p < end && is_name_char(*p))
+    ++p;
+
+  name_len = p - name;
+  while (p < end && is_blank(*p))
+    ++p;
+
+  if (!name_len || p == end || *p++ != '=')
+    return false;
+
+  while (p < end && is_blank(*p))
+    ++p;
+
+  if (p == end || (*p != '"' && *p != '\''))
+    return false;
+
+  char q = *p++;
+  val = p;
+  while (p < end && *p != q)
+    ++p;
+
+  if (p == end)
+    return false;
+
+  val_len = p++ - val;
+  return true;
+}
+
+//! Skip BOM and XML declaration.
+/*! \return false if declaration is not a plain one
+    or specifies encoding other than UTF-8. */
+bool
+skip_prolog(const char*& p, const char* end)
+{
+  if (starts_with(p, end, bom, bom_len))
+    p += bom_len;
+
+  if (!starts_with(p, end, "<?xml", 5) || end - p < 6 || !is_blank(p[5]))
+    return true;
+
+  static const char* const attrs[] = { "version", "encoding", "standalone" };
+  const size_t num_attrs = sizeof(attrs) / sizeof(attrs[0]);
+  const char* q = p + 5;
+
+  for (size_t i = 0;;) {
+    bool blank = false;
+    for (; q < end && is_blank(*q); ++q)
+      blank = true;
+
+    if (starts_with(q, end, "?>", 2) && i) {
+      p = q + 2;
+      return true;
+    }
+
+    const char* name = 0;
+    const char* val = 0;
+    size_t name_len = 0, val_len = 0;
+
+    if (!blank || !read_decl_attr(q, end, name, name_len, val, val_len))
+      return false;
+
+    // Attributes may be omitted but not reordered, version is mandatory.
+    while (i < num_attrs && (strlen(attrs[i]) != name_len || memcmp(attrs[i], name, name_len)))
+    {
+      if (!i++)
+        return false;
+    }
+
+    if (i == num_attrs)
+      return false;
+
+    if (i == 0 && (val_len < 3 || memcmp(val, "1.", 2) ||
+        strspn(val + 2, "0123456789") != val_len - 2))
+      return false;
+
+    if (i == 1 && !equal_nocase(val, val_len, "utf-8") && !equal_nocase(val, val_len, "utf8"))
+      return false;
+
+    if (i == 2 && !equal_nocase(val, val_len, "yes") && !equal_nocase(val, val_len, "no"))
+      return false;
+
+    ++i;
+  }
+}
+
+inline bool
+is_xml_char(unsigned long c)
+{
+  return c == 0x9 || c == 0xA || c == 0xD ||
+    (c >= 0x20 && c <= 0xD7FF) ||
+    (c >= 0xE000 && c <= 0xFFFD) ||
+    (c >= 0x10000 && c <= 0x10FFFF);
+}
+
+//! Throw Parse_error if text is not valid UTF-8 or has characters
+//! not allowed in XML.
+void
+check_chars(const char* p, size_t len)
+{
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+  const unsigned char* e = s + len;
+
+  while (s < e) {
+    unsigned char c = *s++;
+
+    if (c < 0x80) {
+      if (c < 0x20 && c != '\t' && c != '\n' && c != '\r')
+        throw Parse_error("Char 0x" + std::string(1, "0123456789ABCDEF"[c >> 4]) +
+          "0123456789ABCDEF"[c & 0xF] + " out of allowed range");
+
+      continue;
+    }
+
+    size_t n = 0;
+    unsigned long cp = 0;
+
+    if ((c & 0xE0) == 0xC0) {
+      n = 1;
+      cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+      n = 2;
+      cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+      n = 3;
+      cp = c & 0x07;
+    } else {
+      throw Parse_error("Input is not proper UTF-8");
+    }
+
+    if (static_cast<size_t>(e - s) < n)
+      throw Parse_error("Input is not proper UTF-8");
+
+    for (size_t i = 0; i < n; ++i, ++s) {
+      if ((*s & 0xC0) != 0x80)
+        throw Parse_error("Input is not proper UTF-8");
+
+      cp = (cp << 6) | (*s & 0x3F);
+    }
+
+    static const unsigned long min_cp[] = { 0, 0x80, 0x800, 0x10000 };
+    if (cp < min_cp[n] || !is_xml_char(cp))
+      throw Parse_error("Input is not proper UTF-8");
+  }
+}
+
+void
+append_utf8(unsigned long c, std::string& out)
+{
+  if (c < 0x80) {
+    out += static_cast<char>(c);
+  } else if (c < 0x800) {
+    out += static_cast<char>(0xC0 | (c >> 6));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    out += static_cast<char>(0xE0 | (c >> 12));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (c >> 18));
+    out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  }
+}
+
+void
+decode_char_ref(const char* p, size_t len, std::string& out)
+{
+  bool hex = len && (*p == 'x');
+  if (hex) {
+    ++p;
+    --len;
+  }
+
+  unsigned long c = 0;
+  for (size_t i = 0; i < len; ++i) {
+    int d = -1;
+
+    if (p[i] >= '0' && p[i] <= '9')
+      d = p[i] - '0';
+    else if (hex && p[i] >= 'a' && p[i] <= 'f')
+      d = p[i] - 'a' + 10;
+    else if (hex && p[i] >= 'A' && p[i] <= 'F')
+      d = p[i] - 'A' + 10;
+
+    if (d < 0 || c > 0x10FFFF)
+      throw Parse_error("bad character reference");
+
+    c = c * (hex ? 16 : 10) + d;
+  }
+
+  if (!len || !is_xml_char(c))
+    throw Parse_error("invalid character reference");
+
+  append_utf8(c, out);
+}
+
+void
+decode_entity(const char* p, size_t len, std::string& out)
+{
+  if (len && *p == '#')
+    return decode_char_ref(p + 1, len - 1, out);
+
+  static const struct {
+    const char* name;
+    size_t len;
+    char c;
+  } predefined[] = {
+    { "lt",   2, '<' },
+    { "gt",   2, '>' },
+    { "amp",  3, '&' },
+    { "quot", 4, '"' },
+    { "apos", 4, '\'' }
+  };
+
+  for (size_t i = 0; i < sizeof(predefined) / sizeof(predefined[0]); ++i) {
+    if (len == predefined[i].len && !memcmp(p, predefined[i].name, len)) {
+      out += predefined[i].c;
+      return;
+    }
+  }
+
+  throw Parse_error("Entity '" + std::string(p, len) + "' not defined");
+}
+
+//! Append text with references replaced and line ends normalized to LF.
+void
+decode(const Xml_tokenizer::Slice& text, std::string& out)
+{
+  const char* p = text.data;
+  const char* e = p + text.len;
+  out.reserve(out.length() + text.len);
+
+  while (p < e) {
+    const char* s = p;
+    while (p < e && *p != '&' && *p != '\r')
+      ++p;
+
+    out.append(s, p - s);
+    if (p == e)
+      break;
+
+    if (*p == '\r') {
+      out += '\n';
+      if (++p < e && *p == '\n')
+        ++p;
+
+      continue;
+    }
+
+    const char* semi = static_cast<const char*>(memchr(p, ';', e - p));
+    if (!semi)
+      throw Parse_error("EntityRef: expecting ';'");
+
+    decode_entity(p + 1, semi - p - 1, out);
+    p = semi + 1;
+  }
+}
+
+inline bool
+is_blank(const char* p, size_t len)
+{
+  for (size_t i = 0; i < len; ++i) {
+    if (!is_blank(p[i]))
+      return false;
+  }
+
+  return true;
+}
+
+} // anonymous namespace
+
+bool
+Xml_tokenizer::supports(const std::string& buf)
+{
+  return check_prolog(buf.data(), buf.length(), true) == SUPPORTED;
+}
+
+Xml_tokenizer::Support
+Xml_tokenizer::check_prolog(const char* p, size_t len, bool last)
+{
+  const char* end = p + len;
+
+  if (!last) {
+    const char* s = p;
+    if (starts_with(s, end, bom, bom_len))
+      s += bom_len;
+    else if (is_prefix(s, end, bom, bom_len))
+      return UNKNOWN;
+
+    // Whole XML declaration is needed to check it.
+    size_t n = end - s;
+    if (n <= 5 && !memcmp(s, "<?xml", n))
+      return UNKNOWN;
+
+    if (n > 5 && !memcmp(s, "<?xml", 5) && is_blank(s[5]) && !find(s, end, "?>", 2))
+      return UNKNOWN;
+  }
+
+  if (!skip_prolog(p, end))
+    return UNSUPPORTED;
+
+  // Documents in UTF-16 or UTF-32.
+  if (p < end && (*p == '\0' || *p == '\xFE' || *p == '\xFF'))
+    return UNSUPPORTED;
+
+  // Look for DTD among comments and processing instructions before root.
+  for (;;) {
+    while (p < end && is_blank(*p))
+      ++p;
+
+    if (p == end || is_prefix(p, end, "<!--", 4))
+      return last ? SUPPORTED : UNKNOWN;
+
+    const char* term = "-->";
+    if (starts_with(p, end, "<?", 2))
+      term = "?>";
+    else if (!starts_with(p, end, "<!--", 4))
+      return starts_with(p, end, "<!", 2) ? UNSUPPORTED : SUPPORTED;
+
+    const char* q = find(p + 2, end, term, strlen(term));
+    if (!q)
+      return last ? SUPPORTED : UNKNOWN;
+
+    p = q + strlen(term);
+  }
+}
+
+Xml_tokenizer::Xml_tokenizer(const std::string& buf):
+  pos(buf.data()),
+  end(buf.data() + buf.length()),
+  last(true),
+  scanned(0),
+  quote(0),
+  has_refs(false),
+  root_closed(false)
+{
+  skip_prolog(pos, end);
+}
+
+Xml_tokenizer::Xml_tokenizer():
+  pos(0),
+  end(0),
+  last(false),
+  scanned(0),
+  quote(0),
+  has_refs(false),
+  root_closed(false)
+{
+}
+
+void
+Xml_tokenizer::feed(const char* s, size_t len, bool last_part)
+{
+  bool first = !pos;
+  if (!first)
+    buf.erase(0, pos - buf.data());
+
+  buf.append(s, len);
+  pos = buf.data();
+  end = pos + buf.length();
+  last = last_part;
+
+  if (first)
+    skip_prolog(pos, end);
+}
+
+//! Whether token at current position is received entirely.
+bool
+Xml_tokenizer::complete()
+{
+  const char* from = pos + scanned;
+
+  if (*pos != '<') {
+    if (memchr(from, '<', end - from))
+      return true;
+
+    scanned = end - pos;
+    return false;
+  }
+
+  if (is_prefix(pos, end, "<!--", 4) || is_prefix(pos, end, "<![CDATA[", 9))
+    return false;
+
+  const char* term = 0;
+  size_t skip = 0;
+
+  if (starts_with(pos, end, "<!--", 4)) {
+    // Comment ends with the first "--", followed by '>' or not.
+    term = "--";
+    skip = 4;
+  } else if (starts_with(pos, end, "<![CDATA[", 9)) {
+    term = "]]>";
+    skip = 9;
+  } else if (starts_with(pos, end, "<?", 2)) {
+    term = "?>";
+    skip = 2;
+  } else if (starts_with(pos, end, "<!", 2)) {
+    return true;
+  } else {
+    // Tag ends with '>' which is not in attribute value.
+    for (const char* p = from > pos ? from : pos + 1; p < end; ++p) {
+      if (quote) {
+        if (*p == quote)
+          quote = 0;
+      } else if (*p == '"' || *p == '\'') {
+        quote = *p;
+      } else if (*p == '>') {
+        return true;
+      }
+    }
+
+    scanned = end - pos;
+    return false;
+  }
+
+  size_t term_len = strlen(term);
+  const char* q = find(from > pos + skip ? from : pos + skip, end, term, term_len);
+
+  if (q && (*term != '-' || q + term_len < end))
+    return true;
+
+  // Terminator may be split between parts.
+  if (q)
+    scanned = q - pos;
+  else
+    scanned = std::max(skip, static_cast<size_t>(end - pos) - term_len + 1);
+
+  return false;
+}
+
+Xml_tokenizer::Slice
+Xml_tokenizer::open_name() const
+{
+  size_t off = open.back() + 1;
+  return Slice(path_.data() + off, path_.length() - off);
+}
+
+Xml_tokenizer::Token
+Xml_tokenizer::next()
+{
+  for (;;) {
+    if (pos == end) {
+      if (!last)
+        return NEED_MORE;
+
+      if (!open.empty())
+        throw Parse_error("Premature end of data in tag " + to_string(open_name()));
+
+      if (!root_closed)
+        throw Parse_error("Document is empty");
+
+      return END_OF_DOC;
+    }
+
+    if (!last && !complete())
+      return NEED_MORE;
+
+    scanned = 0;
+    quote = 0;
+
+    if (*pos == '<') {
+      Token t = read_tag();
+
+      // Comments and processing instructions around root are skipped.
+      if (t != OTHER || !open.empty())
+        return t;
+
+      continue;
+    }
+
+    const char* lt = static_cast<const char*>(memchr(pos, '<', end - pos));
+    text_ = Slice(pos, (lt ? lt : end) - pos);
+    pos = lt ? lt : end;
+
+    // Text is checked even if nobody reads it. Decoded text
+    // is kept in reused buffer as character reference may stand for
+    // a blank character.
+    check_chars(text_.data, text_.len);
+
+    if (find(text_.data, pos, "]]>", 3))
+      throw Parse_error("Sequence ']]>' not allowed in content");
+
+    has_refs = memchr(text_.data, '&', text_.len) != 0;
+    if (has_refs) {
+      decoded.erase();
+      decode(text_, decoded);
+    }
+
+    if (!open.empty()) {
+      bool blank = has_refs ?
+        is_blank(decoded.data(), decoded.length()) :
+        is_blank(text_.data, text_.len);
+
+      return blank ? WHITESPACE : TEXT;
+    }
+
+    if (!is_blank(text_.data, text_.len)) {
+      throw Parse_error(root_closed ?
+        "Extra content at the end of the document" :
+        "Start tag expected, '<' not found");
+    }
+  }
+}
+
+Xml_tokenizer::Token
+Xml_tokenizer::read_tag()
+{
+  const char* p = pos + 1;
+  if (p == end)
+    throw Parse_error("Premature end of data");
+
+  if (*p == '!' || *p == '?')
+    return read_other();
+
+  bool closing = *p == '/';
+  if (closing)
+    ++p;
+
+  const char* n = p;
+  while (p < end && is_name_char(*p))
+    ++p;
+
+  if (p == n || !is_name_start(*n))
+    throw Parse_error("Invalid element name");
+
+  if (p < end && !is_blank(*p) && *p != '>' && (closing || *p != '/'))
+    throw Parse_error("Invalid element name " + std::string(n, p - n + 1));
+
+  name_ = Slice(n, p - n);
+  pos = p;
+
+  if (closing) {
+    while (pos < end && is_blank(*pos))
+      ++pos;
+
+    if (pos == end || *pos != '>')
+      throw Parse_error("Bad end tag " + to_string(name_));
+
+    ++pos;
+
+    if (open.empty() || !equal(open_name(), name_))
+      throw Parse_error("Opening and ending tag mismatch: " + to_string(name_));
+
+    path_.erase(open.back());
+    open.pop_back();
+    root_closed = open.empty();
+    return ELEMENT_END;
+  }
+
+  if (root_closed)
+    throw Parse_error("Extra content at the end of the document");
+
+  skip_attributes();
+
+  if (*pos == '/') {
+    pos += 2;
+    root_closed = open.empty();
+    return EMPTY_ELEMENT;
+  }
+
+  ++pos;
+  open.push_back(path_.length());
+  path_ += '/';
+  path_.append(name_.data, name_.len);
+  return ELEMENT;
+}
+
+//! Read comment, processing instruction or CDATA section.
+Xml_tokenizer::Token
+Xml_tokenizer::read_other()
+{
+  const char* p = pos + 2;
+  const char* q = 0;
+
+  if (pos[1] == '?') {
+    const char* n = p;
+    while (p < end && is_name_char(*p))
+      ++p;
+
+    if (p == n || !is_name_start(*n))
+      throw Parse_error("xmlParsePI : no target name");
+
+    if (equal_nocase(n, p - n, "xml"))
+      throw Parse_error("XML declaration allowed only at the start of the document");
+
+    q = find(p, end, "?>", 2);
+    if (!q)
+      throw Parse_error("PI not terminated");
+
+    if (q != p && !is_blank(*p))
+      throw Parse_error("ParsePI: PI space expected");
+
+    check_chars(p, q - p);
+    pos = q + 2;
+    return OTHER;
+  }
+
+  if (starts_with(pos, end, "<!--", 4)) {
+    p += 2;
+    q = find(p, end, "--", 2);
+    if (!q || q + 2 == end)
+      throw Parse_error("Comment not terminated");
+
+    if (q[2] != '>')
+      throw Parse_error("Double hyphen within comment");
+
+    check_chars(p, q - p);
+    pos = q + 3;
+    return OTHER;
+  }
+
+  if (starts_with(pos, end, "<![CDATA[", 9) && !open.empty()) {
+    p += 7;
+    q = find(p, end, "]]>", 3);
+    if (!q)
+      throw Parse_error("CData section not finished");
+
+    check_chars(p, q - p);
+    pos = q + 3;
+    return OTHER;
+  }
+
+  throw Parse_error("Unsupported markup");
+}
+
+//! Leaves position at either '>' or "/>".
+void
+Xml_tokenizer::skip_attributes()
+{
+  for (;;) {
+    while (pos < end && is_blank(*pos))
+      ++pos;
+
+    if (pos == end)
+      throw Parse_error("Premature end of data in tag " + to_string(name_));
+
+    if (*pos == '>')
+      return;
+
+    if (*pos == '/') {
+      if (pos + 1 < end && pos[1] == '>')
+        return;
+
+      throw Parse_error("Bad tag " + to_string(name_));
+    }
+
+    const char* a = pos;
+    while (pos < end && is_name_char(*pos))
+      ++pos;
+
+    if (pos == a || !is_name_start(*a))
+      throw Parse_error("Invalid attribute name in tag " + to_string(name_));
+
+    while (pos < end && is_blank(*pos))
+      ++pos;
+
+    if (pos == end || *pos != '=')
+      throw Parse_error("Specification mandates value for attribute");
+
+    ++pos;
+    while (pos < end && is_blank(*pos))
+      ++pos;
+
+    if (pos == end || (*pos != '"' && *pos != '\''))
+      throw Parse_error("AttValue: \" or ' expected");
+
+    const char* q = static_cast<const char*>(memchr(pos + 1, *pos, end - pos - 1));
+    if (!q)
+      throw Parse_error("AttValue: ' expected");
+
+    Slice val(pos + 1, q - pos - 1);
+    if (memchr(val.data, '<', val.len))
+      throw Parse_error("Unescaped '<' not allowed in attributes values");
+
+    check_chars(val.data, val.len);
+    if (memchr(val.data, '&', val.len)) {
+      decoded.erase();
+      decode(val, decoded);
+    }
+
+    pos = q + 1;
+  }
+}
+
+void
+Xml_tokenizer::decode_text(std::string& out) const
+{
+  if (has_refs)
+    out.append(decoded);
+  else
+    decode(text_, out);
+}
+
+std::string
+Xml_tokenizer::path() const
+{
+  return path_.empty() ? "/" : path_;
+}
+
+} // namespace iqxmlrpc
+// vim:sw=2:ts=2:et:
@@ -0,0 +1,114 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_xml_tokenizer_h_
+#define _iqxmlrpc_xml_tokenizer_h_
+
+#include <string>
+#include <vector>
+
+namespace iqxmlrpc {
+
+//! Non-validating pull tokenizer of XML subset used by XML-RPC.
+/*! Tag names and text are returned as slices of the input buffer,
+    text is decoded only on demand. Elements, attributes (which are
+    skipped), character data with predefined and numeric character
+    references, comments, processing instructions, CDATA sections
+    and XML declaration are supported. Tag nesting and characters
+    of text are checked. Documents with DTD or non UTF-8 encoding
+    must be parsed with libxml2 (see supports()). Nothing is loaded
+    from outside and no entities but predefined ones are known,
+    so there is no XXE.
+
+    Document may be either given at once or fed in parts as it is
+    received (see feed()).
+*/
+class Xml_tokenizer {
+public:
+  enum Token {
+    END_OF_DOC,
+    ELEMENT,
+    EMPTY_ELEMENT,
+    ELEMENT_END,
+    TEXT,
+    WHITESPACE, //!< Text of blank characters only.
+    OTHER,      //!< Comment, processing instruction or CDATA section.
+    NEED_MORE   //!< Next token is not received yet, see feed().
+  };
+
+  enum Support {
+    UNSUPPORTED,
+    SUPPORTED,
+    UNKNOWN //!< More data is needed to tell.
+  };
+
+  struct Slice {
+    const char* data;
+    size_t len;
+
+    Slice(): data(0), len(0) {}
+    Slice(const char* d, size_t l): data(d), len(l) {}
+  };
+
+  //! Whether document consists of supported constructs only.
+  static bool supports( const std::string& );
+
+  //! Check whether document is supported by its beginning. Only prolog
+  //! matters as the rest of document is either supported or malformed.
+  static Support check_prolog( const char*, size_t, bool last );
+
+  //! Tokenizer of whole document. Buffer must outlive tokenizer.
+  explicit Xml_tokenizer( const std::string& );
+
+  //! Tokenizer of document received in parts.
+  Xml_tokenizer();
+
+  //! Append next part of document. The first part must be enough for
+  //! check_prolog() to tell whether document is supported. Data of
+  //! tokens read so far is discarded.
+  void feed( const char*, size_t, bool last = false );
+
+  //! Read next token. Throws Parse_error on malformed document.
+  Token next();
+
+  //! Qualified name of current element.
+  Slice name() const { return name_; }
+
+  //! Append decoded text of current TEXT or WHITESPACE token.
+  void decode_text( std::string& ) const;
+
+  //! Path of open elements, e.g. "/methodCall/params".
+  std::string path() const;
+
+private:
+  bool complete();
+  Slice open_name() const;
+  Token read_tag();
+  Token read_other();
+  void skip_attributes();
+
+  //! Received part of document which is fed in parts.
+  std::string buf;
+  const char* pos;
+  const char* end;
+  //! Whether document ends at the end of buffer.
+  bool last;
+  //! Number of bytes after pos which are known not to complete
+  //! current token, and quote of attribute value at that point.
+  size_t scanned;
+  char quote;
+  //! Path of open elements and offsets of their names in it.
+  std::string path_;
+  std::vector<size_t> open;
+  Slice name_;
+  Slice text_;
+  //! Decoded text if it has references.
+  std::string decoded;
+  bool has_refs;
+  bool root_closed;
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:sw=2:ts=2:et:
@@ -3,16 +3,22 @@
 #include <openssl/md5.h>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
 #include "libiqxmlrpc/libiqxmlrpc.h"
 #include "libiqxmlrpc/http_client.h"
 #include "libiqxmlrpc/http_errors.h"
+#include "libiqxmlrpc/socket.h"
 #include "client_common.h"
 #include "client_opts.h"
 
 #if defined(WIN32)
 #include <winsock2.h>
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
 #endif
 
 using namespace boost::unit_test;
@@ -61,14 +67,18 @@ BOOST_AUTO_TEST_CASE( auth_test )
 {
   BOOST_REQUIRE(test_client);
 
-  BOOST_CHECKPOINT("Successful authorization");
+  BOOST_TEST_CHECKPOINT("Successful authorization");
   test_client->set_authinfo("goodman", "loooooooooooooooooongpaaaaaaaaaaaassssswwwwwwoooooord");
   Response retval( test_client->execute("echo_user", 0) );
   BOOST_CHECK( !retval.is_fault() );
   BOOST_CHECK_EQUAL( retval.value().get_string(), "goodman" );
 
+  // Served from server's auth cache if it is on.
+  retval = test_client->execute("echo_user", 0);
+  BOOST_CHECK_EQUAL( retval.value().get_string(), "goodman" );
+
   try {
-    BOOST_CHECKPOINT("Unsuccessful authorization");
+    BOOST_TEST_CHECKPOINT("Unsuccessful authorization");
     test_client->set_authinfo("badman", "");
     retval = test_client->execute("echo_user", 0);
 
@@ -90,6 +100,98 @@ BOOST_AUTO_TEST_CASE( echo_test )
   BOOST_CHECK(retval.value().get_string() == "Hello");
 }
 
+BOOST_AUTO_TEST_CASE( expect_continue_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  // Body is sent as soon as server confirms it, long before the wait ends.
+  test_client->set_expect_continue(1024, 10000);
+  std::string big(100000, 'x');
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  Echo_proxy echo(test_client);
+  Response retval(echo(big));
+  boost::posix_time::time_duration took =
+    boost::posix_time::microsec_clock::universal_time() - start;
+
+  test_client->set_expect_continue(0, 0);
+
+  BOOST_CHECK(retval.value().get_string() == big);
+  BOOST_CHECK(took < boost::posix_time::seconds(5));
+
+  // Small request is sent at once.
+  Response small(echo("Hello"));
+  BOOST_CHECK(small.value().get_string() == "Hello");
+}
+
+BOOST_AUTO_TEST_CASE( split_request_test )
+{
+  if (test_config.use_ssl())
+    return;
+
+  std::string body(
+    "<?xml version=\"1.0\"?><methodCall><methodName>echo</methodName>"
+    "<params><param><value>Split</value></param></params></methodCall>");
+  std::ostringstream head;
+  head << "POST /RPC2 HTTP/1.1\r\n"
+       << "Content-Type: text/xml\r\n"
+       << "Content-Length: " << body.length() << "\r\n\r\n"
+       << body.substr(0, 40);
+  std::string tail(body.substr(40));
+
+  iqnet::Socket sock;
+#if !defined(WIN32)
+  struct timeval tv = { 5, 0 };
+  setsockopt(sock.get_handler(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+  sock.connect(test_config.addr());
+
+  // Server must keep reading a first request which spans several reads.
+  sock.send(head.str().data(), head.str().length());
+  boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+  sock.send(tail.data(), tail.length());
+
+  std::string resp;
+  try {
+    char buf[4096];
+    while (resp.find("</methodResponse>") == std::string::npos)
+    {
+      size_t n = sock.recv(buf, sizeof(buf));
+      if (!n)
+        break;
+      resp.append(buf, n);
+    }
+  } catch (const iqnet::network_error&) {
+    BOOST_ERROR("No response to request sent in two parts");
+  }
+  sock.close();
+
+  BOOST_CHECK_EQUAL(resp.find("HTTP/1.1 200"), 0u);
+  BOOST_CHECK(resp.find("Split") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( pipelined_echo_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  std::vector<Request> reqs;
+  for (int i = 0; i < 50; ++i)
+  {
+    Param_list pl;
+    pl.push_back(Value(i));
+    reqs.push_back(Request("echo", pl));
+  }
+  reqs.push_back(Request("error_method", Param_list()));
+
+  std::vector<Response> retval(test_client->execute_pipelined(reqs));
+  BOOST_REQUIRE_EQUAL(retval.size(), reqs.size());
+
+  for (int i = 0; i < 50; ++i)
+    BOOST_CHECK_EQUAL(retval[i].value().get_int(), i);
+
+  BOOST_CHECK(retval.back().is_fault());
+}
+
 BOOST_AUTO_TEST_CASE( error_method_test )
 {
   BOOST_REQUIRE(test_client);
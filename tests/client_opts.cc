@@ -15,6 +15,7 @@ Client_opts::Client_opts():
   use_ssl_(false),
   stop_server_(false),
   timeout_(0),
+  compress_(false),
   opts_()
 {
   opts_.add_options()
@@ -25,6 +26,7 @@ Client_opts::Client_opts():
     ("use-ssl", value<bool>(&use_ssl_))
     ("stop-server", value<bool>(&stop_server_))
     ("timeout", value<int>(&timeout_))
+    ("compress", value<bool>(&compress_))
     ("server-finger", value<std::string>(&server_fingerprint_));
 }
 
@@ -85,6 +87,8 @@ Client_opts::create_instance() const
   if (timeout())
     retval->set_timeout(timeout());
 
+  retval->set_compress_requests(compress_);
+
   if (use_ssl_ && server_fingerprint_.size()) {
     server_verifier = FingerprintVerifier(server_fingerprint_);
     ssl::ctx->verify_server(&server_verifier.get());
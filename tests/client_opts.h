@@ -18,6 +18,7 @@
  *    --use-ssl
  *    --numthreads
  *    --timeout
+ *    --compress
  */
 class Client_opts {
 public:
@@ -35,6 +36,7 @@ private:
   bool        use_ssl_;
   bool        stop_server_;
   int         timeout_;
+  bool        compress_;
   std::string server_fingerprint_;
 
 protected:
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <sys/time.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include "libiqxmlrpc/net_except.h"
+#include "libiqxmlrpc/socket.h"
+
+using namespace iqnet;
+
+// Request is sent by two writes like HTTP header and body,
+// which is the pattern penalized by Nagle + delayed ACK.
+const size_t header_sz = 150;
+const size_t body_sz = 300;
+const size_t reply_sz = 200;
+const int num_requests = 200;
+
+void recv_all(Socket& s, char* buf, size_t sz)
+{
+  for (size_t got = 0; got < sz;) {
+    size_t n = s.recv(buf + got, sz - got);
+    if (!n)
+      throw network_error("connection closed", false);
+    got += n;
+  }
+}
+
+void serve(Socket* listener, int count)
+{
+  Socket s = listener->accept();
+  s.set_options(Socket_options());
+
+  char buf[header_sz + body_sz];
+  std::string reply(reply_sz, 'r');
+
+  for (int i = 0; i < count; ++i) {
+    recv_all(s, buf, sizeof(buf));
+    s.send(reply.data(), reply.length());
+  }
+
+  s.close();
+}
+
+double measure(bool nodelay)
+{
+  Socket listener;
+  listener.bind(Inet_addr("127.0.0.1", 0));
+  listener.listen();
+  Inet_addr addr("127.0.0.1", listener.get_addr().get_port());
+
+  boost::thread server(boost::bind(serve, &listener, num_requests));
+
+  Socket_options opts;
+  opts.nodelay = nodelay;
+
+  Socket client;
+  client.set_options(opts);
+  client.connect(addr);
+
+  std::string header(header_sz, 'h');
+  std::string body(body_sz, 'b');
+  char reply[reply_sz];
+
+  struct timeval t1, t2;
+  gettimeofday(&t1, 0);
+
+  for (int i = 0; i < num_requests; ++i) {
+    client.send(header.data(), header.length());
+    client.send(body.data(), body.length());
+    recv_all(client, reply, sizeof(reply));
+  }
+
+  gettimeofday(&t2, 0);
+
+  server.join();
+  client.close();
+  listener.close();
+
+  double us = (t2.tv_sec - t1.tv_sec) * 1e6 + (t2.tv_usec - t1.tv_usec);
+  return us / num_requests;
+}
+
+int main(int argc, char* argv[])
+{
+  std::cout << "Average round trip, TCP_NODELAY off: "
+            << measure(false) << " us" << std::endl;
+  std::cout << "Average round trip, TCP_NODELAY on:  "
+            << measure(true) << " us" << std::endl;
+  return 0;
+}
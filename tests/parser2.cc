@@ -2,6 +2,9 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <memory>
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
 #include "libiqxmlrpc/value.h"
@@ -66,6 +69,29 @@ BOOST_AUTO_TEST_CASE(test_parse_array)
   BOOST_CHECK_EQUAL(v[5].the_struct()["v2"].get_int(), 123);
 }
 
+BOOST_AUTO_TEST_CASE(test_parse_numbers)
+{
+  BOOST_CHECK_EQUAL(parse_value("<int>+42</int>").get_int(), 42);
+  BOOST_CHECK_EQUAL(parse_value("<i4>-007</i4>").get_int(), -7);
+  BOOST_CHECK_EQUAL(parse_value("<i4>2147483647</i4>").get_int(), 2147483647);
+  BOOST_CHECK_EQUAL(parse_value("<i4>-2147483648</i4>").get_int(), -2147483647 - 1);
+  BOOST_CHECK_EQUAL(parse_value("<boolean>1</boolean>").get_bool(), true);
+  BOOST_CHECK_EQUAL(parse_value("<double>-0.1</double>").get_double(), -0.1);
+  BOOST_CHECK_EQUAL(parse_value("<double>.5</double>").get_double(), 0.5);
+  BOOST_CHECK_EQUAL(parse_value("<double>1.5e3</double>").get_double(), 1500);
+  BOOST_CHECK_EQUAL(parse_value("<double>1e-400</double>").get_double(), 0);
+
+  const char* bad[] = {
+    "<i4>2147483648</i4>", "<i4>-2147483649</i4>", "<int> 1</int>", "<int>1 </int>",
+    "<int>-</int>", "<int>1.0</int>", "<int>0x1</int>", "<boolean>true</boolean>",
+    "<double>1e400</double>", "<double> 1</double>", "<double>0x10</double>",
+    "<double>1,5</double>", "<double>1e</double>", "<double>-</double>"
+  };
+
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+    BOOST_CHECK_THROW(parse_value(bad[i]), XML_RPC_violation);
+}
+
 BOOST_AUTO_TEST_CASE(test_parse_unknown_type)
 {
   BOOST_CHECK_THROW(parse_value("<abc>0</abc>"), XML_RPC_violation);
@@ -77,6 +103,121 @@ BOOST_AUTO_TEST_CASE(test_parse_bad_xml)
   BOOST_CHECK_THROW(parse_value("<doc></abc></doc>"), Parse_error);
 }
 
+std::string dump_value(const std::string& s, bool native)
+{
+  Parser p(s, native);
+  ValueBuilder b(p);
+  b.build();
+  std::ostringstream ss;
+  print_value(Value(b.result()), ss);
+  return ss.str();
+}
+
+std::string read_file(const std::string& name)
+{
+  std::ifstream f(("data/" + name).c_str());
+  BOOST_REQUIRE_MESSAGE(f, "cannot open data/" + name);
+  std::ostringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+// Standalone <value> is not a document builders accept, pass it as response.
+std::string value_as_response(const std::string& s)
+{
+  size_t decl = s.find("?>");
+  std::string body(decl == std::string::npos ? s : s.substr(decl + 2));
+  return "<methodResponse><params><param>" + body +
+    "</param></params></methodResponse>";
+}
+
+// Dump document with builder chosen by its root element.
+std::string dump_document(const std::string& s, bool native)
+{
+  Parser p(s, native);
+
+  if (s.find("methodCall") != std::string::npos) {
+    RequestBuilder b(p);
+    b.build();
+    std::auto_ptr<Request> req(b.get());
+    return dump_request(*req);
+  }
+
+  if (s.find("methodResponse") != std::string::npos) {
+    ResponseBuilder b(p);
+    b.build();
+    return dump_response(b.get());
+  }
+
+  ValueBuilder b(p);
+  b.build();
+  std::ostringstream ss;
+  print_value(Value(b.result()), ss);
+  return ss.str();
+}
+
+// Readers must agree on errors as well, but not on location reported.
+std::string dump_or_error(const std::string& s, bool native)
+{
+  try {
+    return dump_document(s, native);
+  } catch (const std::exception& e) {
+    std::string msg(e.what());
+    return "error: " + msg.substr(0, msg.find(" at /"));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_native_parser_same_as_libxml)
+{
+  const char* docs[] = {
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<string>a &amp; b &#x41;&#66;</string>",
+    "<struct><member>\r\n<name>k&lt;</name><value>v\r\nw\rx</value></member></struct>",
+    "<array a='1'><data><value><i4>5</i4></value><value/></data></array>",
+    "<!-- comment --><string><![CDATA[<raw>]]></string>",
+    "<ns:string xmlns:ns=\"u\">prefixed</ns:string>"
+  };
+
+  for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i)
+    BOOST_CHECK_EQUAL(dump_value(docs[i], true), dump_value(docs[i], false));
+
+  const char* files[] = {
+    "request.xml", "request-ns.xml", "request2.xml", "request3.xml",
+    "response.xml", "response_fault.xml", "value.xml"
+  };
+
+  for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+    BOOST_TEST_MESSAGE(files[i]);
+    std::string doc(read_file(files[i]));
+    if (doc.find("<value>") < doc.find("<method"))
+      doc = value_as_response(doc);
+
+    BOOST_CHECK_EQUAL(dump_or_error(doc, true), dump_or_error(doc, false));
+  }
+
+  BOOST_CHECK_THROW(parse_value("<string>&unknown;</string>"), Parse_error);
+  BOOST_CHECK_THROW(parse_value("<string>a</string><x>"), Parse_error);
+  BOOST_CHECK_THROW(parse_value("<string>\xC3(</string>"), Parse_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_lookup_tag)
+{
+  const char* names[] = {
+    "array", "base64", "boolean", "data", "dateTime.iso8601", "double",
+    "fault", "i4", "int", "member", "methodCall", "methodName",
+    "methodResponse", "name", "nil", "param", "params", "string",
+    "struct", "value"
+  };
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    std::string n(names[i]);
+    BOOST_CHECK_EQUAL(lookup_tag(n.data(), n.length()), static_cast<XmlRpcTag>(i + 1));
+  }
+
+  BOOST_CHECK_EQUAL(lookup_tag("valuex", 6), TAG_UNKNOWN);
+  BOOST_CHECK_EQUAL(lookup_tag("i8", 2), TAG_UNKNOWN);
+  BOOST_CHECK_EQUAL(lookup_tag("", 0), TAG_UNKNOWN);
+}
+
 BOOST_AUTO_TEST_CASE(test_parse_simple_struct)
 {
   Struct s = parse_value(
@@ -303,6 +444,54 @@ BOOST_AUTO_TEST_CASE(test_parse_malformed_request)
   BOOST_CHECK_THROW(parse_request(r), XML_RPC_violation);
 }
 
+std::auto_ptr<Request> read_request(const std::string& r, size_t part_sz)
+{
+  Request_reader reader;
+  for (size_t i = 0; i < r.length(); i += part_sz)
+    reader.feed(r.substr(i, part_sz));
+
+  return std::auto_ptr<Request>(reader.get());
+}
+
+BOOST_AUTO_TEST_CASE(test_read_request_in_parts)
+{
+  std::string r = "<?xml version=\"1.0\"?>\n<!-- c --><methodCall> \
+  <methodName>get&amp;weather</methodName> \
+  <params> \
+    <param><value><struct><member><name>city</name> \
+      <value><string>Krasnoyarsk</string></value></member></struct></value></param> \
+    <param><value><array><data><value><i4>1</i4></value><value/></data></array></value></param> \
+  </params> \
+</methodCall>";
+
+  for (size_t sz = 1; sz <= 16; ++sz) {
+    std::auto_ptr<Request> req(read_request(r, sz));
+    BOOST_CHECK_EQUAL(req->get_name(), "get&weather");
+    BOOST_CHECK_EQUAL(req->get_params().size(), 2);
+    BOOST_CHECK_EQUAL(req->get_params()[0]["city"].get_string(), "Krasnoyarsk");
+    BOOST_CHECK_EQUAL(req->get_params()[1][0].get_int(), 1);
+    BOOST_CHECK_EQUAL(req->get_params()[1][1].get_string(), "");
+  }
+
+  // libxml2 gets whole document with DTD
+  std::string dtd = "<!DOCTYPE methodCall><methodCall><methodName>m</methodName></methodCall>";
+  BOOST_CHECK_EQUAL(read_request(dtd, 5)->get_name(), "m");
+
+  // Malformed document is reported as such even after builder's error.
+  r = "<methodCall><methodName>m</methodName><params><param><value><i4>x</i4>";
+  BOOST_CHECK_THROW(read_request(r + "</value></param></params></methodCall>", 3), std::exception);
+
+  try {
+    read_request(r + "</value></param></params></method>", 3);
+    BOOST_ERROR("parse error expected");
+  } catch (const Exception& e) {
+    BOOST_CHECK_EQUAL(e.code(), Parse_error("").code());
+  }
+
+  BOOST_CHECK_THROW(read_request("<methodCall><methodName>m</methodName>", 4), Exception);
+  BOOST_CHECK_THROW(read_request("<methodCall></methodCall>", 4), Exception);
+}
+
 //
 // response
 //
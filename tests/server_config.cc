@@ -16,6 +16,14 @@ void throw_bad_config(options_description& opts)
 Test_server_config::Test_server_config(int argc, char** argv):
   port(0),
   numthreads(1),
+  numreactors(1),
+  numshards(-1),
+  timeout(0),
+  maxconns(0),
+  pipeline(1),
+  compress(0),
+  chunk(0),
+  authcache(0),
   use_ssl(false),
   omit_string_tags(false)
 {
@@ -23,6 +31,14 @@ Test_server_config::Test_server_config(int argc, char** argv):
   opts.add_options()
     ("port", value<int>(&port))
     ("numthreads", value<int>(&numthreads))
+    ("numreactors", value<int>(&numreactors))
+    ("numshards", value<int>(&numshards))
+    ("timeout", value<int>(&timeout))
+    ("maxconns", value<int>(&maxconns))
+    ("pipeline", value<int>(&pipeline))
+    ("compress", value<int>(&compress))
+    ("chunk", value<int>(&chunk))
+    ("auth-cache", value<int>(&authcache))
     ("use-ssl", value<bool>(&use_ssl))
     ("omit-string-tags", value<bool>(&omit_string_tags));
 
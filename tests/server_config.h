@@ -9,6 +9,14 @@ struct Test_server_config {
 
   int port;
   int numthreads;
+  int numreactors;
+  int numshards;
+  int timeout;
+  int maxconns;
+  int pipeline;
+  int compress;
+  int chunk;
+  int authcache;
   bool use_ssl;
   bool omit_string_tags;
 
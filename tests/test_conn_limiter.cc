@@ -0,0 +1,124 @@
+#define BOOST_TEST_MODULE conn_limiter_test
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "libiqxmlrpc/conn_limiter.h"
+#include "libiqxmlrpc/executor.h"
+#include "libiqxmlrpc/http_server.h"
+#include "libiqxmlrpc/socket.h"
+
+using namespace boost::unit_test;
+using namespace iqnet;
+
+namespace {
+
+void sleep_ms( int ms )
+{
+  boost::this_thread::sleep( boost::posix_time::milliseconds(ms) );
+}
+
+Socket* connect_to( int port )
+{
+  std::auto_ptr<Socket> sock(new Socket);
+  struct timeval tv = { 5, 0 };
+  setsockopt( sock->get_handler(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+  sock->connect( Inet_addr("127.0.0.1", port) );
+  return sock.release();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( total_limit )
+{
+  Conn_limiter l;
+  Inet_addr peer("127.0.0.1", 1);
+  l.set_max_connections( 10 );
+
+  for (int i = 0; i < 10; ++i)
+    BOOST_CHECK( l.acquire(peer) );
+
+  BOOST_CHECK( l.full() );
+  BOOST_CHECK( !l.acquire(peer) );
+  BOOST_CHECK_EQUAL( l.count(), 10u );
+
+  // Default low watermark is 90% of the limit.
+  l.release( peer );
+  BOOST_CHECK( !l.full() );
+  BOOST_CHECK( !l.below_low_watermark() );
+  l.release( peer );
+  BOOST_CHECK( l.below_low_watermark() );
+  BOOST_CHECK_EQUAL( l.count(), 8u );
+}
+
+BOOST_AUTO_TEST_CASE( per_ip_limit )
+{
+  Conn_limiter l;
+  Inet_addr peer1("127.0.0.1", 1);
+  Inet_addr peer2("127.0.0.2", 1);
+  l.set_max_connections_per_ip( 2 );
+
+  BOOST_CHECK( l.acquire(peer1) );
+  BOOST_CHECK( l.acquire(peer1) );
+  BOOST_CHECK( !l.acquire(peer1) );
+  BOOST_CHECK( l.acquire(peer2) );
+
+  l.release( peer1 );
+  BOOST_CHECK( l.acquire(peer1) );
+  BOOST_CHECK_EQUAL( l.count(), 3u );
+}
+
+BOOST_AUTO_TEST_CASE( server_resumes_accepting )
+{
+  const int port = 3392;
+  iqxmlrpc::Serial_executor_factory ef;
+  iqxmlrpc::Http_server server( Inet_addr("127.0.0.1", port), &ef );
+  server.set_max_connections( 2 );
+
+  boost::thread worker( boost::bind(&iqxmlrpc::Server::work, &server) );
+  sleep_ms( 200 );
+
+  std::auto_ptr<Socket> s1(connect_to(port));
+  std::auto_ptr<Socket> s2(connect_to(port));
+  sleep_ms( 200 );
+
+  // Third client waits in listen queue.
+  std::auto_ptr<Socket> s3(connect_to(port));
+  sleep_ms( 200 );
+  BOOST_CHECK_EQUAL( server.get_num_connections(), 2u );
+
+  s1->close();
+
+  std::string body(
+    "<?xml version=\"1.0\"?><methodCall>"
+    "<methodName>system.listMethods</methodName></methodCall>");
+  std::ostringstream req;
+  req << "POST /RPC2 HTTP/1.1\r\n"
+      << "Content-Length: " << body.length() << "\r\n\r\n"
+      << body;
+  s3->send( req.str().data(), req.str().length() );
+
+  char buf[256];
+  std::string resp;
+  try {
+    size_t sz = s3->recv( buf, sizeof(buf) );
+    resp.assign( buf, sz );
+  } catch (const network_error&) {
+    BOOST_ERROR("Connection from listen queue is not accepted");
+  }
+
+  BOOST_CHECK_EQUAL( resp.find("HTTP/1.1 200"), 0u );
+  BOOST_CHECK_EQUAL( server.get_num_connections(), 2u );
+
+  s2->close();
+  s3->close();
+
+  server.set_exit_flag();
+  worker.join();
+}
@@ -0,0 +1,435 @@
+#define BOOST_TEST_MODULE http_test
+
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "libiqxmlrpc/auth_cache.h"
+#include "libiqxmlrpc/http.h"
+#include "libiqxmlrpc/http_client.h"
+#include "libiqxmlrpc/http_errors.h"
+
+using namespace boost::unit_test;
+using namespace iqxmlrpc;
+using namespace iqxmlrpc::http;
+
+BOOST_AUTO_TEST_CASE( parse_request_header )
+{
+  Request_header h(HTTP_CHECK_STRICT,
+    "POST /RPC2 HTTP/1.1\r\n"
+    "Host: example.com:8080\r\n"
+    "  CONTENT-Length :  123 \r\n"
+    "Content-Type: text/xml; charset=utf-8\r\n"
+    "Connection: Keep-Alive\r\n"
+    "X-Request-Id: abc\r\n"
+    "Accept: */*");
+
+  BOOST_CHECK_EQUAL(h.uri(), "/RPC2");
+  BOOST_CHECK_EQUAL(h.host(), "example.com:8080");
+  BOOST_CHECK_EQUAL(h.agent(), "unknown");
+  BOOST_CHECK_EQUAL(h.content_length(), 123u);
+  BOOST_CHECK(h.conn_keep_alive());
+  BOOST_CHECK(!h.expect_continue());
+  BOOST_CHECK(!h.has_authinfo());
+
+  XHeaders xh;
+  h.get_xheaders(xh);
+  BOOST_CHECK_EQUAL(xh.size(), 1u);
+  BOOST_CHECK_EQUAL(xh.find("x-request-id")->second, "abc");
+}
+
+BOOST_AUTO_TEST_CASE( parse_bare_lf )
+{
+  Request_header h(HTTP_CHECK_WEAK, "POST / HTTP/1.0\nContent-Length: 0\n");
+  BOOST_CHECK_EQUAL(h.content_length(), 0u);
+  BOOST_CHECK(!h.conn_keep_alive());
+}
+
+BOOST_AUTO_TEST_CASE( validators )
+{
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_WEAK,
+    "POST / HTTP/1.0\r\nContent-Length: 12a"), Malformed_packet);
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_WEAK,
+    "POST / HTTP/1.0\r\nContent-Length: 99999999999"), Malformed_packet);
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_WEAK,
+    "POST / HTTP/1.0\r\nno colon"), Malformed_packet);
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_WEAK,
+    "POST / HTTP/1.0\r\nExpect: 200-ok"), Expectation_failed);
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_WEAK,
+    "GET / HTTP/1.0\r\n"), Method_not_allowed);
+
+  // Content type is checked in strict mode only.
+  Request_header(HTTP_CHECK_WEAK, "POST / HTTP/1.0\r\nContent-Type: text/html");
+  BOOST_CHECK_THROW(Request_header(HTTP_CHECK_STRICT,
+    "POST / HTTP/1.0\r\nContent-Type: text/html"), Unsupported_content_type);
+}
+
+BOOST_AUTO_TEST_CASE( parse_response_header )
+{
+  Response_header h(HTTP_CHECK_WEAK,
+    "HTTP/1.1 404 Not Found\r\nServer: test\r\nContent-Length: 5");
+
+  BOOST_CHECK_EQUAL(h.code(), 404);
+  BOOST_CHECK_EQUAL(h.phrase(), "Not Found");
+  BOOST_CHECK_EQUAL(h.server(), "test");
+  BOOST_CHECK_EQUAL(h.content_length(), 5u);
+  BOOST_CHECK(h.conn_keep_alive());
+
+  Response_header h10(HTTP_CHECK_WEAK, "HTTP/1.0 200 OK\r\nContent-Length: 5");
+  BOOST_CHECK(!h10.conn_keep_alive());
+}
+
+BOOST_AUTO_TEST_CASE( dump_header )
+{
+  Request_header h("/RPC2", "localhost", 80);
+  h.set_content_length(10);
+  h.set_content_length(20);
+  h.set_option("X-Id", "1");
+  h.set_option("x-id", "2");
+
+  std::string s = h.dump();
+  BOOST_CHECK_EQUAL(s.find("POST /RPC2 HTTP/1.1\r\n"), 0u);
+  BOOST_CHECK(s.find("connection: close\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("content-length: 20\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("content-length: 10") == std::string::npos);
+  BOOST_CHECK(s.find("X-Id: 2\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("host: localhost:80\r\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(s.substr(s.length() - 4), "\r\n\r\n");
+
+  Request_header parsed(HTTP_CHECK_STRICT, s.substr(0, s.length() - 4));
+  BOOST_CHECK_EQUAL(parsed.content_length(), 20u);
+  BOOST_CHECK_EQUAL(parsed.host(), "localhost:80");
+}
+
+BOOST_AUTO_TEST_CASE( overwrite_options )
+{
+  std::ostringstream ss;
+  ss << "POST /RPC2 HTTP/1.1\r\nContent-Length: 100\r\nHost: example.com";
+  for (int i = 0; i < 12; ++i)
+    ss << "\r\nX-Opt-" << i << ": " << i;
+
+  Request_header h(HTTP_CHECK_WEAK, ss.str());
+  BOOST_CHECK_EQUAL(h.uri(), "/RPC2");
+  BOOST_CHECK_EQUAL(h.version(), "HTTP/1.1");
+
+  h.set_content_length(7);
+  h.set_content_length(123456);
+  h.set_option("Host", "a");
+  h.set_option("x-opt-11", "eleven");
+  h.set_option("x-opt-0", "");
+
+  BOOST_CHECK_EQUAL(h.content_length(), 123456u);
+  BOOST_CHECK_EQUAL(h.host(), "a");
+
+  XHeaders xh;
+  h.get_xheaders(xh);
+  BOOST_CHECK_EQUAL(xh.size(), 12u);
+  BOOST_CHECK_EQUAL(xh.find("x-opt-0")->second, "");
+  BOOST_CHECK_EQUAL(xh.find("x-opt-5")->second, "5");
+  BOOST_CHECK_EQUAL(xh.find("x-opt-11")->second, "eleven");
+
+  std::string s = h.dump();
+  BOOST_CHECK(s.find("content-length: 123456\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("x-opt-9: 9\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("x-opt-11: eleven\r\n") != std::string::npos);
+  BOOST_CHECK(s.find("x-opt-0: \r\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( read_packet_by_chunks )
+{
+  std::string body(1000, 'b');
+  std::string pkt =
+    "POST /RPC2 HTTP/1.0\r\nContent-Length: 1000\r\n\r\n" + body;
+
+  Packet_reader reader;
+  reader.set_verification_level(HTTP_CHECK_WEAK);
+
+  // Chunks split the end of header at every possible position.
+  Packet* p = 0;
+  for (size_t i = 0; i < pkt.length() && !p; i += 3)
+    p = reader.read_request(pkt.data() + i, std::min<size_t>(3, pkt.length() - i));
+
+  BOOST_REQUIRE(p);
+  BOOST_CHECK_EQUAL(p->content(), body);
+  BOOST_CHECK_EQUAL(p->header()->content_length(), 1000u);
+  delete p;
+}
+
+BOOST_AUTO_TEST_CASE( read_pipelined_packets )
+{
+  std::string pkt1 = "POST / HTTP/1.1\r\nContent-Length: 3\r\n\r\none";
+  std::string pkt2 = "POST / HTTP/1.1\r\nConnection: close\r\nContent-Length: 3\r\n\r\ntwo";
+
+  Packet_reader reader;
+  reader.set_verification_level(HTTP_CHECK_WEAK);
+
+  std::auto_ptr<Packet> p(reader.read_request(pkt1 + pkt2.substr(0, 10)));
+  BOOST_REQUIRE(p.get());
+  BOOST_CHECK_EQUAL(p->content(), "one");
+  BOOST_CHECK(p->header()->conn_keep_alive());
+  BOOST_CHECK(reader.has_pending());
+
+  BOOST_CHECK(!reader.read_request(0, 0));
+  BOOST_CHECK(!reader.has_pending());
+
+  p.reset(reader.read_request(pkt2.substr(10)));
+  BOOST_REQUIRE(p.get());
+  BOOST_CHECK_EQUAL(p->content(), "two");
+  BOOST_CHECK(!p->header()->conn_keep_alive());
+}
+
+BOOST_AUTO_TEST_CASE( read_interim_response )
+{
+  std::string data = "HTTP/1.1 100\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+
+  Packet_reader reader;
+  std::auto_ptr<Packet> p(reader.read_response(data, false));
+  BOOST_REQUIRE(p.get());
+  BOOST_CHECK_EQUAL(static_cast<const Response_header*>(p->header())->code(), 100);
+  BOOST_CHECK(p->content().empty());
+
+  p.reset(reader.read_response(0, 0, false));
+  BOOST_REQUIRE(p.get());
+  BOOST_CHECK_EQUAL(p->content(), "ok");
+}
+
+BOOST_AUTO_TEST_CASE( read_chunked_packet )
+{
+  std::vector<std::string> parts;
+  parts.push_back(std::string(5000, 'a'));
+  parts.push_back(std::string(17, 'b'));
+  parts.push_back("c");
+
+  Packet out(new Response_header());
+  out.swap_chunks(parts);
+  BOOST_CHECK(out.chunked());
+  BOOST_CHECK(out.header()->chunked());
+
+  std::string next = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+  std::string data = out.dump() + next;
+
+  // Chunk sizes and terminators are split at every position.
+  Packet_reader reader;
+  std::auto_ptr<Packet> p;
+  size_t i = 0;
+  for (; i < data.length() && !p.get(); i += 2)
+    p.reset(reader.read_response(data.data() + i, std::min<size_t>(2, data.length() - i), false));
+
+  BOOST_REQUIRE(p.get());
+  BOOST_CHECK(p->content() == std::string(5000, 'a') + std::string(17, 'b') + "c");
+  BOOST_CHECK_EQUAL(p->header()->content_length(), 5018u);
+  BOOST_CHECK(!p->header()->chunked());
+
+  // Data which followed the last chunk starts next packet.
+  std::string rest = i < data.length() ? data.substr(i) : std::string();
+  std::auto_ptr<Packet> p2(reader.read_response(rest, false));
+  BOOST_REQUIRE(p2.get());
+  BOOST_CHECK(p2->content().empty());
+
+  Packet_reader bad;
+  BOOST_CHECK_THROW(
+    bad.read_request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"),
+    Malformed_packet);
+}
+
+BOOST_AUTO_TEST_CASE( empty_parts_are_not_sent_as_chunks )
+{
+  std::vector<std::string> parts;
+  parts.push_back("abc");
+  parts.push_back("");
+  parts.push_back("de");
+  parts.push_back("");
+
+  Packet out(new Response_header());
+  out.swap_chunks(parts);
+  BOOST_CHECK(out.chunked());
+
+  std::string dump = out.dump();
+  BOOST_CHECK_EQUAL(dump.substr(dump.find("\r\n\r\n") + 4),
+    "3\r\nabc\r\n2\r\nde\r\n0\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE( take_content_of_incomplete_packet )
+{
+  std::string pipelined = "POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+  std::string plain = "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\n0123456789";
+  std::string chunked = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+    "4\r\n0123\r\n6\r\n456789\r\n0\r\n\r\n";
+
+  std::string datas[] = { plain + pipelined, chunked + pipelined };
+
+  for (size_t n = 0; n < 2; ++n) {
+    const std::string& data = datas[n];
+    Packet_reader reader;
+    std::auto_ptr<Packet> p;
+    std::string taken;
+    size_t i = 0;
+
+    for (; i < data.length() && !p.get(); i += 3) {
+      p.reset(reader.read_request(data.data() + i, std::min<size_t>(3, data.length() - i)));
+
+      std::string part;
+      if (!p.get() && reader.take_content(part))
+        taken += part;
+    }
+
+    BOOST_REQUIRE(p.get());
+    BOOST_CHECK_EQUAL(taken + p->content(), "0123456789");
+    BOOST_CHECK(!taken.empty());
+
+    std::auto_ptr<Packet> p2(reader.read_request(data.substr(i)));
+    BOOST_REQUIRE(p2.get());
+    BOOST_CHECK(p2->content().empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( read_too_large_packet )
+{
+  Packet_reader reader;
+  reader.set_verification_level(HTTP_CHECK_WEAK);
+  reader.set_max_size(100);
+
+  BOOST_CHECK_THROW(
+    reader.read_request("POST / HTTP/1.0\r\nContent-Length: 1000000\r\n\r\n"),
+    Request_too_large);
+}
+
+BOOST_AUTO_TEST_CASE( huge_content_length_is_not_reserved )
+{
+  Packet_reader reader;
+  reader.set_verification_level(HTTP_CHECK_WEAK);
+
+  BOOST_CHECK(!reader.read_request(
+    "POST / HTTP/1.0\r\nContent-Length: 4000000000\r\n\r\n"));
+  BOOST_CHECK(!reader.read_request(std::string(1000, 'a')));
+
+  // Taken content is the reader's buffer itself.
+  std::string s;
+  BOOST_REQUIRE(reader.take_content(s));
+  BOOST_CHECK_EQUAL(s.length(), 1000u);
+  BOOST_CHECK(s.capacity() <= 4 * 65536);
+
+  // Buffer grows along with received data.
+  std::string data(300000, 'b');
+  BOOST_CHECK(!reader.read_request(data));
+  BOOST_REQUIRE(reader.take_content(s));
+  BOOST_CHECK_EQUAL(s.length(), data.length());
+  BOOST_CHECK(s.capacity() < 2 * data.length());
+}
+
+BOOST_AUTO_TEST_CASE( choose_content_coding )
+{
+  if (!content_coding_supported())
+    return;
+
+  BOOST_CHECK_EQUAL(choose_coding(""), CODING_IDENTITY);
+  BOOST_CHECK_EQUAL(choose_coding("deflate, gzip"), CODING_GZIP);
+  BOOST_CHECK_EQUAL(choose_coding("gzip;q=0, deflate"), CODING_DEFLATE);
+  BOOST_CHECK_EQUAL(choose_coding("br, identity"), CODING_IDENTITY);
+  BOOST_CHECK_THROW(parse_coding("compress"), Unsupported_content_encoding);
+}
+
+BOOST_AUTO_TEST_CASE( compressed_content )
+{
+  if (!content_coding_supported())
+    return;
+
+  std::string body;
+  for (int i = 0; i < 1000; ++i)
+    body += "<member><name>field</name><value><i4>1</i4></value></member>";
+
+  Content_coding codings[] = { CODING_GZIP, CODING_DEFLATE };
+  for (size_t i = 0; i < 2; ++i)
+  {
+    Packet pkt(new Response_header(), body);
+    pkt.encode_content(codings[i]);
+    BOOST_CHECK(pkt.content().length() < body.length() / 10);
+
+    Packet_reader reader;
+    std::auto_ptr<Packet> p(reader.read_response(pkt.dump(), false));
+    BOOST_REQUIRE(p.get());
+    BOOST_CHECK_EQUAL(p->header()->content_encoding(), coding_name(codings[i]));
+
+    BOOST_CHECK_THROW(p->decode_content(body.length() - 1), Request_too_large);
+    p->decode_content(body.length());
+    BOOST_CHECK(p->content() == body);
+    BOOST_CHECK_EQUAL(p->header()->content_length(), body.length());
+    BOOST_CHECK(p->header()->content_encoding().empty());
+  }
+
+  std::string garbage("not compressed");
+  BOOST_CHECK_THROW(decode_content(garbage, CODING_GZIP), Malformed_packet);
+}
+
+namespace {
+
+//! Accept one connection, read request and send canned response.
+void serve_once( iqnet::Socket* listener, const std::string& resp )
+{
+  iqnet::Socket conn( listener->accept() );
+
+  std::string req;
+  char buf[1024];
+  while (req.find("</methodCall>") == std::string::npos)
+  {
+    size_t sz = conn.recv( buf, sizeof(buf) );
+    if (!sz)
+      return;
+
+    req.append( buf, sz );
+  }
+
+  for (size_t sent = 0; sent < resp.length();)
+    sent += conn.send( resp.data() + sent, resp.length() - sent );
+
+  conn.close();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( client_limits_decompressed_response )
+{
+  if (!content_coding_supported())
+    return;
+
+  // Zeroes compress about thousand times.
+  Packet bomb(new Response_header(), std::string(4 * 1024 * 1024, '\0'));
+  bomb.encode_content(CODING_GZIP);
+  BOOST_REQUIRE(bomb.content().length() * 100 < 4 * 1024 * 1024);
+
+  const int port = 3393;
+  iqnet::Socket listener;
+  listener.bind( iqnet::Inet_addr("127.0.0.1", port) );
+  listener.listen();
+  boost::thread server( boost::bind(&serve_once, &listener, bomb.dump()) );
+
+  Client<Http_client_connection> client( iqnet::Inet_addr("127.0.0.1", port) );
+  client.set_timeout( 5 );
+  BOOST_CHECK_THROW( client.execute("echo", Param_list()), Malformed_packet );
+
+  server.join();
+  listener.close();
+}
+
+BOOST_AUTO_TEST_CASE( auth_cache )
+{
+  Auth_cache cache(2, 60);
+  std::string user;
+
+  cache.insert("Basic a", "alice");
+  cache.insert("Basic b", "bob");
+  BOOST_CHECK(!cache.find("basic a", user));
+  BOOST_CHECK(cache.find("Basic a", user));
+  BOOST_CHECK_EQUAL(user, "alice");
+
+  // Least recently used entry is evicted.
+  cache.insert("Basic c", "carol");
+  BOOST_CHECK(!cache.find("Basic b", user));
+  BOOST_CHECK(cache.find("Basic a", user));
+  BOOST_CHECK(cache.find("Basic c", user));
+
+  Auth_cache expired(10, 0);
+  expired.insert("Basic a", "alice");
+  BOOST_CHECK(!expired.find("Basic a", user));
+}
@@ -132,6 +132,19 @@ Test_server::Test_server(const Test_server_config& conf):
   impl_->set_verification_level(http::HTTP_CHECK_STRICT);
 
   impl_->set_auth_plugin(auth_plugin_);
+  impl_->set_auth_cache(conf.authcache, 60);
+  impl_->set_num_reactors(conf.numreactors);
+
+  if (conf.numshards >= 0)
+    impl_->set_num_shards(conf.numshards);
+
+  impl_->set_idle_timeout(conf.timeout);
+  impl_->set_header_timeout(conf.timeout);
+  impl_->set_body_timeout(conf.timeout);
+  impl_->set_max_connections(conf.maxconns);
+  impl_->set_max_pipelined_requests(conf.pipeline);
+  impl_->set_compression_threshold(conf.compress);
+  impl_->set_response_chunk_sz(conf.chunk);
 
   register_user_methods(impl());
 }
@@ -0,0 +1,195 @@
+#define BOOST_TEST_MODULE timers_test
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <memory>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "libiqxmlrpc/executor.h"
+#include "libiqxmlrpc/http_server.h"
+#include "libiqxmlrpc/reactor.h"
+#include "libiqxmlrpc/socket.h"
+#include "libiqxmlrpc/timer_wheel.h"
+
+using namespace boost::unit_test;
+using namespace iqnet;
+
+namespace {
+
+//! Handler of pipe's read end which counts timeouts.
+class Pipe_handler: public Event_handler {
+  int fds[2];
+
+public:
+  int timeouts;
+
+  Pipe_handler():
+    timeouts(0)
+  {
+    BOOST_REQUIRE(!pipe(fds));
+  }
+
+  ~Pipe_handler()
+  {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  void handle_timeout( bool& )
+  {
+    timeouts++;
+  }
+
+  Socket::Handler get_handler() const { return fds[0]; }
+};
+
+boost::posix_time::ptime now()
+{
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+//! Run reactor for specified number of milliseconds.
+void run_for( Reactor_base* reactor, int ms )
+{
+  boost::posix_time::ptime end = now() + boost::posix_time::milliseconds(ms);
+
+  while (now() < end)
+    reactor->handle_events( static_cast<int>((end - now()).total_milliseconds()) );
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( timer_expires )
+{
+  iqxmlrpc::Serial_executor_factory ef;
+  std::auto_ptr<Reactor_base> reactor(ef.create_reactor());
+  Pipe_handler h;
+
+  reactor->register_handler( &h, Reactor_base::INPUT );
+  reactor->set_timer( &h, 100 );
+
+  boost::posix_time::ptime start = now();
+  while (!h.timeouts && now() - start < boost::posix_time::seconds(2))
+    reactor->handle_events( 1000 );
+
+  BOOST_CHECK_EQUAL( h.timeouts, 1 );
+  BOOST_CHECK( now() - start >= boost::posix_time::milliseconds(50) );
+
+  run_for( reactor.get(), 200 );
+  BOOST_CHECK_EQUAL( h.timeouts, 1 );
+}
+
+BOOST_AUTO_TEST_CASE( timer_cancelled )
+{
+  iqxmlrpc::Serial_executor_factory ef;
+  std::auto_ptr<Reactor_base> reactor(ef.create_reactor());
+  Pipe_handler h;
+
+  reactor->register_handler( &h, Reactor_base::INPUT );
+  reactor->set_timer( &h, 50 );
+  reactor->set_timer( &h, 0 );
+  run_for( reactor.get(), 200 );
+  BOOST_CHECK_EQUAL( h.timeouts, 0 );
+}
+
+BOOST_AUTO_TEST_CASE( wheel_next_timeout_is_exact )
+{
+  Timer_wheel wheel;
+  Pipe_handler h1, h2;
+
+  // Idle timeouts are longer than blocks of lower levels,
+  // deadlines are rounded up to the timer resolution.
+  wheel.set( &h1, 60000 );
+  BOOST_CHECK_GT( wheel.next_timeout(), 59900 );
+  BOOST_CHECK_LE( wheel.next_timeout(), 60050 );
+
+  wheel.set( &h2, 100 );
+  BOOST_CHECK_LE( wheel.next_timeout(), 150 );
+
+  wheel.cancel( h2.get_handler() );
+  BOOST_CHECK_GT( wheel.next_timeout(), 59900 );
+
+  wheel.cancel( h1.get_handler() );
+  BOOST_CHECK_EQUAL( wheel.next_timeout(), -1 );
+}
+
+BOOST_AUTO_TEST_CASE( wheel_timer_moved_down )
+{
+  Timer_wheel wheel;
+  Pipe_handler h1, h2;
+  Timer_wheel::Expired_list expired;
+
+  // Both are set beyond the first block of level 0.
+  wheel.set( &h1, 3300 );
+  wheel.set( &h2, 3600 );
+  Timer_wheel::Msec start = Timer_wheel::now();
+
+  while (expired.empty() && Timer_wheel::now() - start < 5000)
+  {
+    usleep( wheel.next_timeout() * 1000 );
+    wheel.expire( expired );
+  }
+
+  BOOST_REQUIRE_EQUAL( expired.size(), 1u );
+  BOOST_CHECK( expired[0].handler == &h1 );
+  BOOST_CHECK_GE( Timer_wheel::now() - start, 3300 );
+  BOOST_CHECK_LE( wheel.next_timeout(), 300 );
+  BOOST_CHECK( !wheel.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( timer_dropped_on_unregister )
+{
+  iqxmlrpc::Serial_executor_factory ef;
+  std::auto_ptr<Reactor_base> reactor(ef.create_reactor());
+  Pipe_handler h;
+
+  // Same handler registered again must not get the old timer.
+  reactor->register_handler( &h, Reactor_base::INPUT );
+  reactor->set_timer( &h, 50 );
+  reactor->unregister_handler( &h );
+  reactor->register_handler( &h, Reactor_base::INPUT );
+
+  run_for( reactor.get(), 200 );
+  BOOST_CHECK_EQUAL( h.timeouts, 0 );
+}
+
+BOOST_AUTO_TEST_CASE( server_header_timeout )
+{
+  const int port = 3391;
+  iqxmlrpc::Serial_executor_factory ef;
+  iqxmlrpc::Http_server server( Inet_addr("127.0.0.1", port), &ef );
+  server.set_header_timeout( 1 );
+
+  boost::thread worker( boost::bind(&iqxmlrpc::Server::work, &server) );
+  boost::this_thread::sleep( boost::posix_time::milliseconds(200) );
+
+  Socket sock;
+  struct timeval tv = { 5, 0 };
+  setsockopt( sock.get_handler(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+
+  boost::posix_time::ptime start = now();
+  sock.connect( Inet_addr("127.0.0.1", port) );
+
+  std::string head("POST /RPC2 HTTP/1.1\r\n");
+  sock.send( head.data(), head.length() );
+
+  // Server closes connection which does not send the whole header in time.
+  char buf[256];
+  size_t sz = 1;
+  try {
+    sz = sock.recv( buf, sizeof(buf) );
+  } catch (const network_error&) {
+    BOOST_ERROR("Connection is not closed by header timeout");
+  }
+
+  BOOST_CHECK_EQUAL( sz, 0u );
+  BOOST_CHECK( now() - start < boost::posix_time::seconds(4) );
+  sock.close();
+
+  server.set_exit_flag();
+  worker.join();
+}